@@ -8,12 +8,25 @@ layout(set = 0, binding = 0) uniform  SceneData{
 	vec4 sunlightColor;
 } sceneData;
 
-layout(set = 1, binding = 0) uniform GLTFMaterialData{
+struct MaterialData{
 
 	vec4 colorFactors;
 	vec4 metal_rough_factors;
+	//slots in the bindless heap
+	uint colorTexture;
+	uint colorSampler;
+	uint metalRoughTexture;
+	uint metalRoughSampler;
 
-} materialData;
+};
 
-layout(set = 1, binding = 1) uniform sampler2D colorTex;
-layout(set = 1, binding = 2) uniform sampler2D metalRoughTex;
\ No newline at end of file
+//every material, indexed by the draw's material index
+layout(std430, set = 0, binding = 1) readonly buffer MaterialTable{
+
+	MaterialData materials[];
+
+} materialTable;
+
+//the bindless heap, every texture and sampler the materials use
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
\ No newline at end of file
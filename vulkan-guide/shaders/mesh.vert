@@ -2,12 +2,14 @@
 
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "input_structures.glsl"
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec2 outUV;
+layout (location = 3) flat out uint outMaterialIndex;
 
 struct Vertex {
 
@@ -27,6 +29,7 @@ layout( push_constant ) uniform constants
 {
 	mat4 render_matrix;
 	VertexBuffer vertexBuffer;
+	uint materialIndex;
 } PushConstants;
 
 void main() 
@@ -38,7 +41,10 @@ void main()
 	gl_Position =  sceneData.viewproj * PushConstants.render_matrix *position;
 
 	outNormal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
+	MaterialData materialData = materialTable.materials[PushConstants.materialIndex];
+
 	outColor = v.color.xyz * materialData.colorFactors.xyz;	
 	outUV.x = v.uv_x;
 	outUV.y = v.uv_y;
+	outMaterialIndex = PushConstants.materialIndex;
 }
\ No newline at end of file
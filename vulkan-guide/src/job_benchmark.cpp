@@ -0,0 +1,152 @@
+#include <job_system.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+
+#include <fmt/core.h>
+
+namespace {
+double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+// results are checked as well as timed, a scheduler that loses or repeats
+// jobs would otherwise just look fast
+void check(bool condition, const char *what) {
+  if (!condition) {
+    fmt::print("job benchmark: {} failed\n", what);
+    abort();
+  }
+}
+
+void bench_empty_jobs(JobSystem &jobs) {
+  constexpr uint32_t jobCount = 1'000'000;
+
+  std::atomic<uint32_t> executed{0};
+  JobCounter counter;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < jobCount; i++) {
+    jobs.run([&]() { executed.fetch_add(1, std::memory_order_relaxed); },
+             &counter);
+  }
+  jobs.wait(counter);
+  double ms = elapsed_ms(start);
+
+  check(executed == jobCount, "empty jobs");
+  fmt::print("empty jobs:     {:>9} jobs {:9.2f} ms {:10.0f} jobs/s\n",
+             jobCount, ms, jobCount / (ms / 1000.0));
+}
+
+void bench_parallel_for(JobSystem &jobs) {
+  constexpr uint32_t count = 1 << 24;
+  std::vector<float> values(count);
+  std::iota(values.begin(), values.end(), 0.f);
+
+  auto work = [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      values[i] = std::sqrt(values[i]) * 0.5f + 1.f;
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+  work(0, count);
+  double serialMs = elapsed_ms(start);
+
+  start = std::chrono::high_resolution_clock::now();
+  jobs.parallel_for(count, 16384, work);
+  double parallelMs = elapsed_ms(start);
+
+  // every element went through the function twice
+  float expected = std::sqrt(std::sqrt(float(count - 1)) * 0.5f + 1.f) * 0.5f +
+                   1.f;
+  check(std::abs(values[count - 1] - expected) < 1e-3f, "parallel_for");
+  fmt::print("parallel_for:   serial {:9.2f} ms parallel {:9.2f} ms "
+             "speedup {:5.2f}x\n",
+             serialMs, parallelMs, serialMs / parallelMs);
+}
+
+void bench_dependencies(JobSystem &jobs) {
+  // a fan-out / fan-in chain: every stage spawns its jobs from a
+  // continuation of the previous stage
+  constexpr uint32_t stages = 1000;
+  constexpr uint32_t jobsPerStage = 64;
+
+  std::vector<JobCounter> counters(stages);
+  std::atomic<uint32_t> executed{0};
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint32_t stage = 0; stage < stages; stage++) {
+    for (uint32_t j = 0; j < jobsPerStage; j++) {
+      auto job = [&, stage]() {
+        // all jobs of the previous stage have to be done by now
+        if (stage > 0) {
+          check(counters[stage - 1].done(), "dependency order");
+        }
+        executed.fetch_add(1, std::memory_order_relaxed);
+      };
+      if (stage == 0) {
+        jobs.run(job, &counters[stage]);
+      } else {
+        jobs.run_after(counters[stage - 1], job, &counters[stage]);
+      }
+    }
+  }
+  jobs.wait(counters[stages - 1]);
+  double ms = elapsed_ms(start);
+
+  check(executed == stages * jobsPerStage, "dependencies");
+  fmt::print("dependencies:   {:>9} jobs {:9.2f} ms in {} stages\n",
+             stages * jobsPerStage, ms, stages);
+}
+
+void bench_nested(JobSystem &jobs) {
+  // parallel_for from inside jobs, waiting threads have to keep running jobs
+  // or this deadlocks
+  constexpr uint32_t outer = 256;
+  constexpr uint32_t inner = 4096;
+
+  std::atomic<uint64_t> sum{0};
+
+  auto start = std::chrono::high_resolution_clock::now();
+  jobs.parallel_for(outer, 1, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      jobs.parallel_for(inner, 256, [&](uint32_t b, uint32_t e) {
+        uint64_t local = 0;
+        for (uint32_t k = b; k < e; k++) {
+          local += k;
+        }
+        sum.fetch_add(local, std::memory_order_relaxed);
+      });
+    }
+  });
+  double ms = elapsed_ms(start);
+
+  check(sum == uint64_t(outer) * inner * (inner - 1) / 2, "nested");
+  fmt::print("nested:         {:>9} jobs {:9.2f} ms\n", outer * inner / 256,
+             ms);
+}
+} // namespace
+
+// throughput of the scheduler, built as jobsystem_bench. the stress checks
+// are in job_stress_test.cpp
+int main(int argc, char *argv[]) {
+  // worker threads besides the main thread, 0 for one per hardware thread
+  uint32_t workers = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 0;
+
+  JobSystem jobs;
+  jobs.init(workers);
+  fmt::print("job system: {} threads\n", jobs.thread_count());
+
+  bench_empty_jobs(jobs);
+  bench_parallel_for(jobs);
+  bench_dependencies(jobs);
+  bench_nested(jobs);
+
+  jobs.shutdown();
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <job_system.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+#include <fmt/core.h>
+
+// correctness checks for the scheduler under load, built as jobsystem_stress
+// and run by ctest. a failed check or a wait that never returns aborts, so
+// the exit code is the result
+namespace {
+void check(bool condition, const char *what) {
+  if (!condition) {
+    fmt::print("job stress test: {} failed\n", what);
+    abort();
+  }
+}
+
+// aborts the process if the test is still running after the timeout, a
+// lost job shows up as a wait that never returns
+class Watchdog {
+public:
+  explicit Watchdog(std::chrono::seconds timeout) {
+    _thread = std::thread([this, timeout]() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (!_done.wait_for(lock, timeout, [this]() { return _finished; })) {
+        fmt::print("job stress test: timed out, a wait did not return\n");
+        abort();
+      }
+    });
+  }
+
+  ~Watchdog() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _finished = true;
+    }
+    _done.notify_all();
+    _thread.join();
+  }
+
+private:
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _done;
+  bool _finished{false};
+};
+
+// every job marks its own slot, each slot has to end up at exactly one
+void stress_exactly_once(JobSystem &jobs) {
+  constexpr uint32_t jobCount = 200'000;
+
+  auto runs = std::make_unique<std::atomic<uint32_t>[]>(jobCount);
+  JobCounter counter;
+  for (uint32_t i = 0; i < jobCount; i++) {
+    jobs.run([&runs, i]() { runs[i].fetch_add(1, std::memory_order_relaxed); },
+             &counter);
+  }
+  jobs.wait(counter);
+
+  for (uint32_t i = 0; i < jobCount; i++) {
+    check(runs[i].load() == 1, "every job runs exactly once");
+  }
+}
+
+// jobs that queue more jobs, so workers push and steal from each other's
+// queues at the same time
+void stress_spawning_jobs(JobSystem &jobs) {
+  constexpr uint32_t parents = 1000;
+  constexpr uint32_t children = 64;
+
+  auto runs = std::make_unique<std::atomic<uint32_t>[]>(parents * children);
+  JobCounter counter;
+  for (uint32_t p = 0; p < parents; p++) {
+    jobs.run(
+        [&, p]() {
+          for (uint32_t c = 0; c < children; c++) {
+            uint32_t slot = p * children + c;
+            jobs.run([&runs, slot]() { runs[slot].fetch_add(1); }, &counter);
+          }
+        },
+        &counter);
+  }
+  jobs.wait(counter);
+
+  for (uint32_t i = 0; i < parents * children; i++) {
+    check(runs[i].load() == 1, "spawned jobs run exactly once");
+  }
+}
+
+// threads the job system doesn't own submit and wait on their own counters
+// side by side, while their jobs wait on nested parallel_fors
+void stress_contended_waits(JobSystem &jobs) {
+  constexpr uint32_t submitters = 8;
+  constexpr uint32_t rounds = 200;
+  constexpr uint32_t jobsPerRound = 64;
+
+  std::atomic<uint64_t> executed{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < submitters; t++) {
+    threads.emplace_back([&]() {
+      for (uint32_t round = 0; round < rounds; round++) {
+        JobCounter counter;
+        for (uint32_t j = 0; j < jobsPerRound; j++) {
+          jobs.run(
+              [&]() {
+                jobs.parallel_for(16, 1, [&](uint32_t begin, uint32_t end) {
+                  executed.fetch_add(end - begin);
+                });
+              },
+              &counter);
+        }
+        jobs.wait(counter);
+        check(counter.done(), "wait returns with the counter at zero");
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  check(executed == uint64_t(submitters) * rounds * jobsPerRound * 16,
+        "contended waits");
+}
+
+// chains of continuations released while other threads keep queueing
+void stress_dependencies(JobSystem &jobs) {
+  constexpr uint32_t stages = 2000;
+  constexpr uint32_t jobsPerStage = 16;
+
+  std::vector<JobCounter> counters(stages);
+  std::atomic<uint32_t> executed{0};
+  for (uint32_t stage = 0; stage < stages; stage++) {
+    for (uint32_t j = 0; j < jobsPerStage; j++) {
+      auto job = [&, stage]() {
+        if (stage > 0) {
+          check(counters[stage - 1].done(), "dependency order");
+        }
+        executed.fetch_add(1);
+      };
+      if (stage == 0) {
+        jobs.run(job, &counters[stage]);
+      } else {
+        jobs.run_after(counters[stage - 1], job, &counters[stage]);
+      }
+    }
+  }
+  jobs.wait(counters[stages - 1]);
+
+  check(executed == stages * jobsPerStage, "dependencies");
+}
+
+void run_all(uint32_t workers) {
+  JobSystem jobs;
+  jobs.init(workers);
+  fmt::print("job stress test: {} threads\n", jobs.thread_count());
+
+  // the checks repeat, races that are rare per run need the rounds
+  for (int i = 0; i < 5; i++) {
+    stress_exactly_once(jobs);
+    stress_spawning_jobs(jobs);
+    stress_contended_waits(jobs);
+    stress_dependencies(jobs);
+  }
+
+  jobs.shutdown();
+}
+} // namespace
+
+int main() {
+  Watchdog watchdog(std::chrono::seconds(120));
+
+  // a single worker has the most contention on one queue, the hardware
+  // count the most stealing
+  run_all(1);
+  run_all(3);
+  run_all(0);
+
+  fmt::print("job stress test: passed\n");
+  return 0;
+}
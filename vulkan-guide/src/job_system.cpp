@@ -0,0 +1,206 @@
+#include <job_system.h>
+
+#include <algorithm>
+
+namespace {
+thread_local uint32_t t_threadIndex = 0;
+} // namespace
+
+void JobSystem::init(uint32_t workerCount) {
+  if (workerCount == 0) {
+    workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  }
+
+  _stop = false;
+  for (uint32_t i = 0; i < workerCount + 1; i++) {
+    _queues.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  for (uint32_t i = 1; i < workerCount + 1; i++) {
+    _workers.emplace_back([this, i]() {
+      t_threadIndex = i;
+      worker_loop(i);
+    });
+  }
+}
+
+void JobSystem::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _stop = true;
+  }
+  _wakeWorkers.notify_all();
+
+  for (std::thread &worker : _workers) {
+    worker.join();
+  }
+  _workers.clear();
+  _queues.clear();
+}
+
+uint32_t JobSystem::thread_index() { return t_threadIndex; }
+
+void JobSystem::run(std::function<void()> job, JobCounter *counter) {
+  if (counter) {
+    counter->_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  push(Job{std::move(job), counter});
+}
+
+void JobSystem::run_after(JobCounter &dependency, std::function<void()> job,
+                          JobCounter *counter) {
+  if (counter) {
+    counter->_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    // finish() takes the same lock to release the continuations, so the job
+    // is either parked here before that or pushed right away below
+    std::lock_guard<std::mutex> lock(dependency._mutex);
+    if (!dependency.done()) {
+      dependency._continuations.push_back({std::move(job), counter});
+      return;
+    }
+  }
+
+  push(Job{std::move(job), counter});
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  while (!counter.done()) {
+    if (!try_run_one()) {
+      std::this_thread::yield();
+    }
+  }
+
+  // the thread that finished the last job may still be unlocking the
+  // counter, it must not be destroyed before that
+  std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+void JobSystem::parallel_for(
+    uint32_t count, uint32_t batchSize,
+    const std::function<void(uint32_t, uint32_t)> &function) {
+  if (count == 0) {
+    return;
+  }
+  batchSize = std::max(1u, batchSize);
+
+  // a single batch isn't worth a trip through the queues
+  if (count <= batchSize || _queues.size() <= 1) {
+    function(0, count);
+    return;
+  }
+
+  JobCounter counter;
+  for (uint32_t begin = 0; begin < count; begin += batchSize) {
+    uint32_t end = std::min(begin + batchSize, count);
+    run([&function, begin, end]() { function(begin, end); }, &counter);
+  }
+  wait(counter);
+}
+
+void JobSystem::push(Job &&job) {
+  // without workers there is nobody to hand the job to
+  if (_queues.empty()) {
+    execute(job);
+    return;
+  }
+
+  // counted before the job is visible, a thief that takes it right away
+  // must not decrement the count below zero
+  _queuedJobs.fetch_add(1, std::memory_order_release);
+
+  uint32_t index = std::min<uint32_t>(t_threadIndex, _queues.size() - 1);
+  {
+    std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+    _queues[index]->jobs.push_back(std::move(job));
+  }
+
+  // a worker may be between checking for jobs and going to sleep, taking
+  // the lock makes sure it either sees the job or gets the notification
+  { std::lock_guard<std::mutex> lock(_sleepMutex); }
+  _wakeWorkers.notify_one();
+}
+
+bool JobSystem::try_run_one() {
+  Job job;
+  if (!pop_or_steal(t_threadIndex, job)) {
+    return false;
+  }
+  execute(job);
+  return true;
+}
+
+bool JobSystem::pop_or_steal(uint32_t threadIndex, Job &outJob) {
+  uint32_t queueCount = static_cast<uint32_t>(_queues.size());
+  if (queueCount == 0) {
+    return false;
+  }
+  threadIndex = std::min(threadIndex, queueCount - 1);
+
+  // newest own job first, its data is most likely still in cache
+  {
+    WorkerQueue &own = *_queues[threadIndex];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      outJob = std::move(own.jobs.back());
+      own.jobs.pop_back();
+      _queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  // steal the oldest job of someone else, those tend to be the biggest
+  for (uint32_t i = 1; i < queueCount; i++) {
+    WorkerQueue &victim = *_queues[(threadIndex + i) % queueCount];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      outJob = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      _queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void JobSystem::execute(Job &job) {
+  job.function();
+  finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter *counter) {
+  if (!counter) {
+    return;
+  }
+
+  std::vector<JobCounter::Continuation> ready;
+  {
+    std::lock_guard<std::mutex> lock(counter->_mutex);
+    if (counter->_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    ready.swap(counter->_continuations);
+  }
+
+  for (JobCounter::Continuation &continuation : ready) {
+    push(Job{std::move(continuation.function), continuation.counter});
+  }
+}
+
+void JobSystem::worker_loop(uint32_t threadIndex) {
+  while (!_stop) {
+    Job job;
+    if (pop_or_steal(threadIndex, job)) {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    _wakeWorkers.wait(lock, [this]() {
+      return _stop || _queuedJobs.load(std::memory_order_acquire) > 0;
+    });
+  }
+}
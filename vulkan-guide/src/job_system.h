@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// tracks a group of jobs. it counts the jobs that have been submitted against
+// it but not finished yet, and holds the jobs that wait for it to reach zero
+class JobCounter {
+public:
+  bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+
+  struct Continuation {
+    std::function<void()> function;
+    JobCounter *counter;
+  };
+
+  std::atomic<uint32_t> _pending{0};
+  std::mutex _mutex;
+  std::vector<Continuation> _continuations;
+};
+
+// work stealing scheduler. every thread owns a deque: it pushes and pops its
+// own jobs at the back, idle threads steal the oldest jobs from the front of
+// the others. thread 0 is the thread that called init(), it runs jobs only
+// while it waits on a counter
+class JobSystem {
+public:
+  // workerCount 0 starts one worker per hardware thread besides the caller
+  void init(uint32_t workerCount = 0);
+  void shutdown();
+
+  // workers + the main thread
+  uint32_t thread_count() const { return (uint32_t)_queues.size(); }
+
+  // index of the calling thread, 0 for the main thread and any thread the
+  // job system does not own
+  static uint32_t thread_index();
+
+  // queues a job. if a counter is given, it stays above zero until the job
+  // has finished
+  void run(std::function<void()> job, JobCounter *counter = nullptr);
+
+  // queues a job once dependency reaches zero. counter is raised right away,
+  // so waiting on it covers the job while it is still held back
+  void run_after(JobCounter &dependency, std::function<void()> job,
+                 JobCounter *counter = nullptr);
+
+  // blocks until the counter reaches zero, running queued jobs meanwhile
+  void wait(JobCounter &counter);
+
+  // splits [0, count) into ranges of at most batchSize and runs
+  // function(begin, end) for each, returning once all ranges are done
+  void parallel_for(uint32_t count, uint32_t batchSize,
+                    const std::function<void(uint32_t, uint32_t)> &function);
+
+private:
+  struct Job {
+    std::function<void()> function;
+    JobCounter *counter;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void push(Job &&job);
+  // pops from the calling thread's own queue, then steals from the others
+  bool try_run_one();
+  bool pop_or_steal(uint32_t threadIndex, Job &outJob);
+  void execute(Job &job);
+  void finish(JobCounter *counter);
+  void worker_loop(uint32_t threadIndex);
+
+  std::vector<std::unique_ptr<WorkerQueue>> _queues;
+  std::vector<std::thread> _workers;
+
+  // idle workers sleep until jobs get queued. raised before a job is
+  // pushed and lowered after it is popped, so it never drops below the
+  // number of jobs in the queues
+  std::atomic<uint32_t> _queuedJobs{0};
+  std::mutex _sleepMutex;
+  std::condition_variable _wakeWorkers;
+  std::atomic<bool> _stop{false};
+};
@@ -1,14 +1,127 @@
 #include <vk_engine.h>
+#include <vk_profiler.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
 
 int main(int argc, char* argv[])
 {
 	VulkanEngine engine;
 
-	engine.init();	
-	
-	engine.run();	
+	// --headless              render offscreen, without a window or swapchain
+	// --frames <n>            draw n frames and print frame time percentiles
+	// --readback <file.ppm>   headless only, copy frames back and save the last
+	// --frames-in-flight <n>  number of frames the cpu may run ahead, 1 to 4
+	// --present-mode <mode>   fifo, mailbox, immediate or fifo_relaxed
+	// --latency-target <ms>   limit how far the cpu queues frames ahead
+	// --record-threads <n>    threads recording the geometry pass
+	// --record-sweep          benchmark every record thread count in turn
+	// --scene-copies <n>      draw the test scene n times
+	// --trace <file.json>     write a chrome trace of the profiled zones at exit
+	// --gpu-csv <file.csv>    write per pass gpu timings at exit
+	// --no-async-compute      keep the background on the graphics queue
+	// --vma-json <file.json>  write vma's memory statistics at exit
+	// --no-descriptor-buffer  bind the geometry pass from descriptor pools
+	// --per-frame-uniform-buffers  a vma buffer per frame for the scene
+	//                         uniforms instead of the linear allocator
+	// --descriptor-benchmark  time descriptor pools against descriptor buffers
+	uint32_t benchmarkFrames = 0;
+	uint32_t framesInFlight = 0;
+	uint32_t recordThreads = 0;
+	bool recordSweep = false;
+	bool descriptorBenchmark = false;
+	const char* readbackPath = nullptr;
+	const char* tracePath = nullptr;
+	const char* gpuCsvPath = nullptr;
+	const char* vmaJsonPath = nullptr;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--headless") {
+			engine._headless = true;
+		} else if (arg == "--frames" && i + 1 < argc) {
+			benchmarkFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+		} else if (arg == "--readback" && i + 1 < argc) {
+			engine._headlessReadback = true;
+			readbackPath = argv[++i];
+		} else if (arg == "--frames-in-flight" && i + 1 < argc) {
+			framesInFlight = static_cast<uint32_t>(std::atoi(argv[++i]));
+		} else if (arg == "--present-mode" && i + 1 < argc) {
+			if (!parse_present_policy(argv[++i], engine._presentPolicy)) {
+				fmt::println("unknown present mode {}", argv[i]);
+			}
+		} else if (arg == "--latency-target" && i + 1 < argc) {
+			engine._frameLimiter.targetLatencyMs = static_cast<float>(std::atof(argv[++i]));
+		} else if (arg == "--record-threads" && i + 1 < argc) {
+			recordThreads = static_cast<uint32_t>(std::atoi(argv[++i]));
+		} else if (arg == "--record-sweep") {
+			recordSweep = true;
+		} else if (arg == "--scene-copies" && i + 1 < argc) {
+			engine._sceneCopies = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+		} else if (arg == "--gpu-csv" && i + 1 < argc) {
+			gpuCsvPath = argv[++i];
+		} else if (arg == "--vma-json" && i + 1 < argc) {
+			vmaJsonPath = argv[++i];
+		} else if (arg == "--no-async-compute") {
+			engine._asyncComputeAllowed = false;
+		} else if (arg == "--no-descriptor-buffer") {
+			engine._descriptorBuffersAllowed = false;
+		} else if (arg == "--per-frame-uniform-buffers") {
+			engine._perFrameUniformBuffers = true;
+		} else if (arg == "--descriptor-benchmark") {
+			descriptorBenchmark = true;
+		}
+	}
+
+	// a headless engine has no event loop, so it always runs a benchmark
+	if ((engine._headless || recordSweep) && benchmarkFrames == 0) {
+		benchmarkFrames = 1000;
+	}
+
+	engine.init();
+
+	if (framesInFlight > 0) {
+		engine.set_frames_in_flight(framesInFlight);
+	}
+	if (recordThreads > 0) {
+		engine.set_record_threads(recordThreads);
+	}
+
+	if (descriptorBenchmark) {
+		engine.run_descriptor_benchmark(benchmarkFrames > 0 ? benchmarkFrames : 1000, 1000);
+	} else if (recordSweep) {
+		engine.run_recording_benchmark(benchmarkFrames);
+	} else if (benchmarkFrames > 0) {
+		engine.run_benchmark(benchmarkFrames);
+
+		if (readbackPath && !engine.write_readback_ppm(readbackPath)) {
+			fmt::println("failed to write readback image to {}", readbackPath);
+		}
+	} else {
+		engine.run();
+	}
+
+	if (gpuCsvPath && !engine._gpuPassStats.write_csv(gpuCsvPath)) {
+		fmt::println("failed to write gpu timings to {}", gpuCsvPath);
+	}
+
+	if (vmaJsonPath && !engine._memoryTelemetry.write_json(vmaJsonPath)) {
+		fmt::println("failed to write memory statistics to {}", vmaJsonPath);
+	}
+
+#ifdef ENGINE_PROFILING
+	if (tracePath && !profiler::write_chrome_trace(tracePath)) {
+		fmt::println("failed to write trace to {}", tracePath);
+	}
+#else
+	if (tracePath) {
+		fmt::println("profiling is only compiled into Debug builds or with -DENGINE_PROFILING=ON, no trace written");
+	}
+#endif
 
-	engine.cleanup();	
+	engine.cleanup();
 
 	return 0;
 }
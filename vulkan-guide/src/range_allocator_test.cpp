@@ -0,0 +1,68 @@
+#include <vk_range_allocator.h>
+
+#include <cstdlib>
+
+#include <fmt/core.h>
+
+// checks for the free list the geometry pool suballocates meshes with,
+// built as range_allocator_test and run by ctest
+namespace {
+void check(bool condition, const char *what) {
+  if (!condition) {
+    fmt::print("range allocator test: {} failed\n", what);
+    abort();
+  }
+}
+
+// a freed range is what the next allocation of the same size gets, so a
+// load and unload cycle doesn't grow the pool
+void freed_range_is_reused() {
+  RangeAllocator ranges;
+  ranges.init(1000);
+
+  uint32_t a, b, c;
+  check(ranges.allocate(100, a), "allocate a");
+  check(ranges.allocate(200, b), "allocate b");
+  check(ranges.allocate(300, c), "allocate c");
+
+  ranges.free(b, 200);
+  uint32_t reused;
+  check(ranges.allocate(200, reused), "allocate after free");
+  check(reused == b, "freed range is reused");
+
+  // a smaller range is placed at the start of the hole
+  ranges.free(reused, 200);
+  check(ranges.allocate(50, reused) && reused == b, "first fit");
+  check(ranges.used() == 450, "used count");
+}
+
+// neighbours are merged, so freeing everything gives one range back
+void free_ranges_merge() {
+  RangeAllocator ranges;
+  ranges.init(300);
+
+  uint32_t offsets[3];
+  for (uint32_t &offset : offsets) {
+    check(ranges.allocate(100, offset), "fill");
+  }
+  uint32_t full;
+  check(!ranges.allocate(1, full), "full allocator refuses");
+
+  // middle last, so it merges with a range on each side
+  ranges.free(offsets[0], 100);
+  ranges.free(offsets[2], 100);
+  ranges.free(offsets[1], 100);
+  check(ranges.used() == 0, "empty after freeing everything");
+
+  uint32_t whole;
+  check(ranges.allocate(300, whole) && whole == 0, "merged into one range");
+}
+} // namespace
+
+int main() {
+  freed_range_is_reused();
+  free_ranges_merge();
+
+  fmt::print("range allocator test: passed\n");
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include <vk_bindless.h>
+
+#include <algorithm>
+
+#include <vk_descriptors.h>
+
+void BindlessHeap::init(VkDevice device, VkPhysicalDevice physicalDevice,
+                        uint32_t maxImages, uint32_t maxSamplers,
+                        const DescriptorBufferDevice *descriptorBuffers,
+                        VmaAllocator allocator) {
+  _device = device;
+  _allocator = allocator;
+  _descriptorBuffers = descriptorBuffers;
+
+  VkPhysicalDeviceVulkan12Properties properties12 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+  VkPhysicalDeviceProperties2 properties = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  properties.pNext = &properties12;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+  if (_descriptorBuffers) {
+    const VkPhysicalDeviceLimits &limits = properties.properties.limits;
+    _maxImages = std::min({maxImages, limits.maxDescriptorSetSampledImages,
+                           limits.maxPerStageDescriptorSampledImages});
+    _maxSamplers = std::min({maxSamplers, limits.maxDescriptorSetSamplers,
+                             limits.maxPerStageDescriptorSamplers});
+  } else {
+    _maxImages = std::min(
+        {maxImages,
+         properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+         properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    _maxSamplers =
+        std::min({maxSamplers,
+                  properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                  properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+  }
+
+  DescriptorLayoutBuilder builder;
+  builder.add_binding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+  builder.add_binding(1, VK_DESCRIPTOR_TYPE_SAMPLER);
+  builder.bindings[0].descriptorCount = _maxImages;
+  builder.bindings[1].descriptorCount = _maxSamplers;
+
+  // unwritten slots are never indexed, and slots are written while frames
+  // index other ones. descriptor buffer writes are plain memory writes, the
+  // update after bind flags don't apply to them
+  VkDescriptorBindingFlags bindingFlags[2];
+  for (VkDescriptorBindingFlags &flags : bindingFlags) {
+    flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    if (!_descriptorBuffers) {
+      flags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+  }
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+      .sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+  flagsInfo.bindingCount = 2;
+  flagsInfo.pBindingFlags = bindingFlags;
+
+  if (_descriptorBuffers) {
+    _layout = builder.build(
+        _device, VK_SHADER_STAGE_FRAGMENT_BIT, &flagsInfo,
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    VkDeviceSize size;
+    _descriptorBuffers->getLayoutSize(_device, _layout, &size);
+    _buffer.init(_device, _allocator, _descriptorBuffers, size,
+                 VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                     VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT);
+    _bufferSet = _buffer.allocate(_layout);
+    return;
+  }
+
+  _layout = builder.build(
+      _device, VK_SHADER_STAGE_FRAGMENT_BIT, &flagsInfo,
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+  VkDescriptorPoolSize poolSizes[] = {
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, _maxImages},
+      {VK_DESCRIPTOR_TYPE_SAMPLER, _maxSamplers}};
+  VkDescriptorPoolCreateInfo poolInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = 2;
+  poolInfo.pPoolSizes = poolSizes;
+  VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+  VkDescriptorSetAllocateInfo allocInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  allocInfo.descriptorPool = _pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &_layout;
+  VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_set));
+}
+
+void BindlessHeap::cleanup() {
+  if (_descriptorBuffers) {
+    _buffer.destroy(_allocator);
+    _bufferSet = {};
+  }
+  vkDestroyDescriptorPool(_device, _pool, nullptr);
+  unregister_descriptor_layout(_layout);
+  vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+  _pool = VK_NULL_HANDLE;
+  _layout = VK_NULL_HANDLE;
+  _set = VK_NULL_HANDLE;
+  _imageCount = 0;
+  _freeImages.clear();
+  _retiredImages.clear();
+  _samplers.clear();
+  _fallbackImage = UINT32_MAX;
+}
+
+uint32_t BindlessHeap::add_image(VkImageView view) {
+  uint32_t slot;
+  if (!_freeImages.empty()) {
+    slot = _freeImages.back();
+    _freeImages.pop_back();
+  } else {
+    if (_imageCount == _maxImages) {
+      if (_fallbackImage == UINT32_MAX) {
+        fmt::println("bindless heap is out of image slots ({})", _maxImages);
+        abort();
+      }
+      if (_imageFallbacks++ == 0) {
+        fmt::println("bindless heap is out of image slots ({}), new images "
+                     "sample the fallback image",
+                     _maxImages);
+      }
+      return _fallbackImage;
+    }
+    slot = _imageCount++;
+  }
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageView = view;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  write(0, slot, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, imageInfo);
+
+  return slot;
+}
+
+void BindlessHeap::retire_image(uint32_t slot, uint64_t value) {
+  if (slot == _fallbackImage) {
+    return;
+  }
+  _retiredImages.push_back({slot, value});
+}
+
+void BindlessHeap::free_image(uint32_t slot) {
+  if (slot == _fallbackImage) {
+    return;
+  }
+  _freeImages.push_back(slot);
+}
+
+void BindlessHeap::collect(uint64_t completedValue) {
+  size_t count = 0;
+  while (count < _retiredImages.size() &&
+         _retiredImages[count].retireValue <= completedValue) {
+    _freeImages.push_back(_retiredImages[count].slot);
+    count++;
+  }
+  _retiredImages.erase(_retiredImages.begin(),
+                       _retiredImages.begin() + count);
+}
+
+uint32_t BindlessHeap::sampler_index(VkSampler sampler) {
+  auto it = std::find(_samplers.begin(), _samplers.end(), sampler);
+  if (it != _samplers.end()) {
+    return static_cast<uint32_t>(it - _samplers.begin());
+  }
+
+  if (_samplers.size() == _maxSamplers) {
+    if (_samplers.empty()) {
+      fmt::println("bindless heap is out of sampler slots ({})", _maxSamplers);
+      abort();
+    }
+    if (_samplerFallbacks++ == 0) {
+      fmt::println("bindless heap is out of sampler slots ({}), new samplers "
+                   "use slot 0",
+                   _maxSamplers);
+    }
+    return 0;
+  }
+  uint32_t slot = static_cast<uint32_t>(_samplers.size());
+  _samplers.push_back(sampler);
+
+  VkDescriptorImageInfo samplerInfo = {};
+  samplerInfo.sampler = sampler;
+  write(1, slot, VK_DESCRIPTOR_TYPE_SAMPLER, samplerInfo);
+
+  return slot;
+}
+
+void BindlessHeap::write(uint32_t binding, uint32_t slot,
+                         VkDescriptorType type,
+                         const VkDescriptorImageInfo &info) {
+  VkWriteDescriptorSet write = {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+  write.dstSet = _set;
+  write.dstBinding = binding;
+  write.dstArrayElement = slot;
+  write.descriptorCount = 1;
+  write.descriptorType = type;
+  write.pImageInfo = &info;
+
+  if (_descriptorBuffers) {
+    DescriptorWriter writer;
+    writer.writes.push_back(write);
+    writer.update_buffer(_device, *_descriptorBuffers, _bufferSet);
+  } else {
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+  }
+}
+
+BindlessHeap::Stats BindlessHeap::stats() const {
+  Stats stats;
+  stats.images = _imageCount - static_cast<uint32_t>(_freeImages.size() +
+                                                     _retiredImages.size());
+  stats.imageCapacity = _maxImages;
+  stats.samplers = static_cast<uint32_t>(_samplers.size());
+  stats.samplerCapacity = _maxSamplers;
+  stats.imageFallbacks = _imageFallbacks;
+  stats.samplerFallbacks = _samplerFallbacks;
+  return stats;
+}
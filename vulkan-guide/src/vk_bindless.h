@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vk_descriptors.h>
+#include <vk_types.h>
+
+// one descriptor set holding every sampled image and sampler the materials
+// use, bound once per command buffer. shaders index its arrays with the
+// slots stored in the material table. the arrays are partially bound and
+// updated after bind, so new slots are written while frames that use other
+// slots are in flight. a freed image slot is reused only once the frames
+// that could still index it are done. with descriptor buffers the set
+// lives in its own host visible descriptor buffer instead, written in place
+// and bound by offset. main thread only
+class BindlessHeap {
+public:
+  // the array sizes are clamped to the device's update after bind limits,
+  // or to the plain per stage limits with descriptor buffers
+  void init(VkDevice device, VkPhysicalDevice physicalDevice,
+            uint32_t maxImages, uint32_t maxSamplers,
+            const DescriptorBufferDevice *descriptorBuffers = nullptr,
+            VmaAllocator allocator = VK_NULL_HANDLE);
+  void cleanup();
+
+  VkDescriptorSetLayout layout() const { return _layout; }
+  VkDescriptorSet set() const { return _set; }
+
+  bool uses_descriptor_buffer() const { return _descriptorBuffers; }
+  const DescriptorBufferAllocator &descriptor_buffer() const {
+    return _buffer;
+  }
+  VkDeviceSize buffer_offset() const { return _bufferSet.offset; }
+
+  // the view has to be in SHADER_READ_ONLY_OPTIMAL when it is sampled.
+  // once every slot is taken it returns the fallback slot
+  uint32_t add_image(VkImageView view);
+  // the slot add_image hands out when the heap is full, so a load that
+  // overflows it samples the fallback image instead of failing. retiring
+  // or freeing the slot does nothing
+  void set_fallback_image(uint32_t slot) { _fallbackImage = slot; }
+  // the slot is reused once collect() sees the frame timeline reach value
+  void retire_image(uint32_t slot, uint64_t value);
+  // the gpu has to be done with the slot
+  void free_image(uint32_t slot);
+  void collect(uint64_t completedValue);
+
+  // the sampler's slot, written on first use. samplers live as long as the
+  // heap. once every slot is taken, new samplers get the first one's slot
+  uint32_t sampler_index(VkSampler sampler);
+
+  struct Stats {
+    uint32_t images{0};
+    uint32_t imageCapacity{0};
+    uint32_t samplers{0};
+    uint32_t samplerCapacity{0};
+    // handed the fallback slot because the heap was full
+    uint64_t imageFallbacks{0};
+    uint64_t samplerFallbacks{0};
+  };
+  Stats stats() const;
+
+private:
+  void write(uint32_t binding, uint32_t slot, VkDescriptorType type,
+             const VkDescriptorImageInfo &info);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  const DescriptorBufferDevice *_descriptorBuffers{nullptr};
+  DescriptorBufferAllocator _buffer;
+  DescriptorBufferSet _bufferSet{};
+  VkDescriptorPool _pool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout _layout{VK_NULL_HANDLE};
+  VkDescriptorSet _set{VK_NULL_HANDLE};
+  uint32_t _maxImages{0};
+  uint32_t _maxSamplers{0};
+
+  // slots below _imageCount were handed out, _freeImages lists the ones
+  // that can be handed out again
+  uint32_t _imageCount{0};
+  std::vector<uint32_t> _freeImages;
+
+  struct RetiredSlot {
+    uint32_t slot;
+    uint64_t retireValue;
+  };
+  // in retire order, retireValue never decreases
+  std::vector<RetiredSlot> _retiredImages;
+
+  // indexed by slot
+  std::vector<VkSampler> _samplers;
+
+  uint32_t _fallbackImage{UINT32_MAX};
+  uint64_t _imageFallbacks{0};
+  uint64_t _samplerFallbacks{0};
+};
@@ -0,0 +1,118 @@
+#include <vk_defragmenter.h>
+
+void set_defrag_owner(VmaAllocator allocator, VmaAllocation allocation,
+                      DefragOwner owner, uint32_t id) {
+  uint64_t userData = (static_cast<uint64_t>(owner) << 32) | id;
+  vmaSetAllocationUserData(allocator, allocation,
+                           reinterpret_cast<void *>(userData));
+}
+
+DefragOwner get_defrag_owner(VmaAllocator allocator, VmaAllocation allocation,
+                             uint32_t &outId) {
+  VmaAllocationInfo info;
+  vmaGetAllocationInfo(allocator, allocation, &info);
+  uint64_t userData = reinterpret_cast<uint64_t>(info.pUserData);
+  outId = static_cast<uint32_t>(userData);
+  return static_cast<DefragOwner>(userData >> 32);
+}
+
+void Defragmenter::init(VkDevice device, VmaAllocator allocator,
+                        VkDeviceSize maxBytesPerPass,
+                        uint32_t maxMovesPerPass) {
+  _device = device;
+  _allocator = allocator;
+  _maxBytesPerPass = maxBytesPerPass;
+  _maxMovesPerPass = maxMovesPerPass;
+}
+
+void Defragmenter::cleanup() {
+  if (_passValue != 0) {
+    end_pass();
+  }
+  if (running()) {
+    finish();
+  }
+}
+
+void Defragmenter::start() {
+  if (running()) {
+    return;
+  }
+
+  // fast only moves allocations into free space of fuller blocks, the
+  // cheapest way to empty the blocks that have little left in them
+  VmaDefragmentationInfo info = {};
+  info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT;
+  info.maxBytesPerPass = _maxBytesPerPass;
+  info.maxAllocationsPerPass = _maxMovesPerPass;
+  VK_CHECK(vmaBeginDefragmentation(_allocator, &info, &_context));
+  _stats.defragmentations++;
+}
+
+void Defragmenter::collect(uint64_t completedValue) {
+  if (_passValue != 0 && completedValue >= _passValue) {
+    end_pass();
+  }
+}
+
+void Defragmenter::step(VkCommandBuffer cmd, uint64_t passValue,
+                        const MoveCallback &callback) {
+  if (!running() || _passValue != 0) {
+    return;
+  }
+
+  VkResult result = vmaBeginDefragmentationPass(_allocator, _context, &_pass);
+  if (result == VK_SUCCESS) {
+    finish();
+    return;
+  }
+  if (result != VK_INCOMPLETE) {
+    VK_CHECK(result);
+  }
+
+  for (uint32_t i = 0; i < _pass.moveCount; i++) {
+    _pass.pMoves[i].operation = callback(_pass.pMoves[i], cmd);
+  }
+  _passValue = passValue;
+  _stats.passes++;
+}
+
+void Defragmenter::retire_image(VkImage image, VkImageView view) {
+  _oldImages.push_back(image);
+  _oldViews.push_back(view);
+}
+
+void Defragmenter::end_pass() {
+  // the old resources are bound to the memory VMA is about to free
+  for (VkImageView view : _oldViews) {
+    vkDestroyImageView(_device, view, nullptr);
+  }
+  for (VkImage image : _oldImages) {
+    vkDestroyImage(_device, image, nullptr);
+  }
+  _oldViews.clear();
+  _oldImages.clear();
+
+  VkResult result = vmaEndDefragmentationPass(_allocator, _context, &_pass);
+  _passValue = 0;
+  if (result == VK_SUCCESS) {
+    finish();
+  } else if (result != VK_INCOMPLETE) {
+    VK_CHECK(result);
+  }
+}
+
+void Defragmenter::finish() {
+  VmaDefragmentationStats stats = {};
+  vmaEndDefragmentation(_allocator, _context, &stats);
+  _context = VK_NULL_HANDLE;
+
+  _stats.allocationsMoved += stats.allocationsMoved;
+  _stats.bytesMoved += stats.bytesMoved;
+  _stats.bytesFreed += stats.bytesFreed;
+  _stats.blocksFreed += stats.deviceMemoryBlocksFreed;
+  fmt::println("defragmentation moved {} allocations ({} bytes), freed {} "
+               "blocks ({} bytes)",
+               stats.allocationsMoved, stats.bytesMoved,
+               stats.deviceMemoryBlocksFreed, stats.bytesFreed);
+}
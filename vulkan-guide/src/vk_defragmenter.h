@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vk_types.h>
+
+// what an allocation holds, kept in its VMA user data so a move can find the
+// resource to replace. allocations without an owner are never moved
+enum class DefragOwner : uint8_t {
+  None,
+  // id is an ImageHandle value
+  PooledImage,
+};
+
+void set_defrag_owner(VmaAllocator allocator, VmaAllocation allocation,
+                      DefragOwner owner, uint32_t id);
+DefragOwner get_defrag_owner(VmaAllocator allocator, VmaAllocation allocation,
+                             uint32_t &outId);
+
+// incremental defragmentation of the default VMA pools, one bounded pass at
+// a time. a pass's moves are handed to a callback, which creates the new
+// resource on the move's temporary allocation, records the copy into the
+// frame's command buffer and points every reference at the new resource.
+// the old resources are given back with retire_*() and destroyed once the
+// frame timeline has passed the pass, then the pass ends and VMA frees the
+// old memory. main thread only
+class Defragmenter {
+public:
+  void init(VkDevice device, VmaAllocator allocator,
+            VkDeviceSize maxBytesPerPass, uint32_t maxMovesPerPass);
+  // ends a running defragmentation, the device has to be idle
+  void cleanup();
+
+  // starts a defragmentation, unless one is running
+  void start();
+  bool running() const { return _context != VK_NULL_HANDLE; }
+
+  // records the copies of a move into cmd and returns
+  // VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY, or returns IGNORE to keep the
+  // allocation where it is
+  using MoveCallback = std::function<VmaDefragmentationMoveOperation(
+      const VmaDefragmentationMove &move, VkCommandBuffer cmd)>;
+
+  // ends the pending pass once the timeline has reached it. has to run
+  // before retired resources are destroyed, a moved allocation must stay
+  // alive until its pass ends
+  void collect(uint64_t completedValue);
+  // begins the next pass, unless one is pending. passValue is what cmd's
+  // submit signals on the frame timeline. finishes the defragmentation when
+  // VMA has nothing left to move
+  void step(VkCommandBuffer cmd, uint64_t passValue,
+            const MoveCallback &callback);
+
+  // resources replaced by the pending pass. their memory stays with the
+  // moved allocation, so only the handles are destroyed
+  void retire_image(VkImage image, VkImageView view);
+
+  struct Stats {
+    uint64_t defragmentations{0};
+    uint64_t passes{0};
+    uint64_t allocationsMoved{0};
+    VkDeviceSize bytesMoved{0};
+    // memory given back to the driver
+    VkDeviceSize bytesFreed{0};
+    uint64_t blocksFreed{0};
+  };
+  const Stats &stats() const { return _stats; }
+
+private:
+  void end_pass();
+  void finish();
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  VkDeviceSize _maxBytesPerPass{0};
+  uint32_t _maxMovesPerPass{0};
+
+  VmaDefragmentationContext _context{VK_NULL_HANDLE};
+  VmaDefragmentationPassMoveInfo _pass{};
+  // the frame timeline value the pending pass's copies signal, 0 if no pass
+  // is pending
+  uint64_t _passValue{0};
+
+  std::vector<VkImage> _oldImages;
+  std::vector<VkImageView> _oldViews;
+
+  Stats _stats;
+};
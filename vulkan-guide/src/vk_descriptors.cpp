@@ -1,5 +1,39 @@
 ﻿#include <vk_descriptors.h>
 
+#include <algorithm>
+#include <cstring>
+#include <shared_mutex>
+#include <unordered_map>
+
+// the per type descriptor counts of the layouts DescriptorLayoutBuilder
+// built, for the allocators' usage tracking. layouts get built on loading
+// threads while recording threads allocate. the allocators copy what they
+// use into a cache of their own, so allocating doesn't take the lock
+static std::shared_mutex layoutSizesMutex;
+static std::unordered_map<VkDescriptorSetLayout,
+                          std::vector<VkDescriptorPoolSize>>
+    layoutSizes;
+
+static void add_descriptors(std::vector<VkDescriptorPoolSize> &sizes,
+                            VkDescriptorType type, uint32_t count);
+
+// false for layouts the builder didn't make
+static bool descriptor_layout_sizes(VkDescriptorSetLayout layout,
+                                    std::vector<VkDescriptorPoolSize> &out) {
+  std::shared_lock lock(layoutSizesMutex);
+  auto it = layoutSizes.find(layout);
+  if (it == layoutSizes.end()) {
+    return false;
+  }
+  out = it->second;
+  return true;
+}
+
+void unregister_descriptor_layout(VkDescriptorSetLayout layout) {
+  std::unique_lock lock(layoutSizesMutex);
+  layoutSizes.erase(layout);
+}
+
 void DescriptorLayoutBuilder::add_binding(uint32_t binding,
                                           VkDescriptorType type) {
   VkDescriptorSetLayoutBinding newbind{};
@@ -31,9 +65,129 @@ DescriptorLayoutBuilder::build(VkDevice device, VkShaderStageFlags shaderStages,
   VkDescriptorSetLayout set;
   VK_CHECK(vkCreateDescriptorSetLayout(device, &info, nullptr, &set));
 
+  std::vector<VkDescriptorPoolSize> sizes;
+  for (const VkDescriptorSetLayoutBinding &b : bindings) {
+    add_descriptors(sizes, b.descriptorType, b.descriptorCount);
+  }
+  {
+    std::unique_lock lock(layoutSizesMutex);
+    layoutSizes[set] = std::move(sizes);
+  }
+
   return set;
 }
 
+DescriptorUpdateTemplate
+DescriptorLayoutBuilder::build_template(VkDevice device,
+                                        VkDescriptorSetLayout layout) const {
+  DescriptorUpdateTemplate updateTemplate;
+
+  std::vector<VkDescriptorUpdateTemplateEntry> entries;
+  for (const VkDescriptorSetLayoutBinding &b : bindings) {
+    size_t stride;
+    switch (b.descriptorType) {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+      stride = sizeof(VkDescriptorBufferInfo);
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+      stride = sizeof(VkDescriptorImageInfo);
+      break;
+    default:
+      fmt::println("descriptor type {} has no update template entry",
+                   string_VkDescriptorType(b.descriptorType));
+      abort();
+    }
+
+    VkDescriptorUpdateTemplateEntry entry = {};
+    entry.dstBinding = b.binding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = b.descriptorCount;
+    entry.descriptorType = b.descriptorType;
+    entry.offset = updateTemplate.dataSize;
+    entry.stride = stride;
+    entries.push_back(entry);
+
+    updateTemplate.dataSize += stride * b.descriptorCount;
+  }
+
+  VkDescriptorUpdateTemplateCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+  info.descriptorUpdateEntryCount = (uint32_t)entries.size();
+  info.pDescriptorUpdateEntries = entries.data();
+  info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  info.descriptorSetLayout = layout;
+
+  VK_CHECK(vkCreateDescriptorUpdateTemplate(device, &info, nullptr,
+                                            &updateTemplate.handle));
+  return updateTemplate;
+}
+
+DescriptorBufferTemplate DescriptorLayoutBuilder::build_buffer_template(
+    VkDevice device, VkDescriptorSetLayout layout,
+    const DescriptorBufferDevice &descriptorBuffers) const {
+  DescriptorBufferTemplate bufferTemplate;
+  for (const VkDescriptorSetLayoutBinding &b : bindings) {
+    if ((b.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER &&
+         b.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) ||
+        b.descriptorCount != 1) {
+      fmt::println("descriptor type {} has no descriptor buffer template "
+                   "entry",
+                   string_VkDescriptorType(b.descriptorType));
+      abort();
+    }
+
+    DescriptorBufferTemplate::Entry entry;
+    entry.type = b.descriptorType;
+    descriptorBuffers.getBindingOffset(device, layout, b.binding,
+                                       &entry.offset);
+    entry.size = descriptorBuffers.descriptor_size(b.descriptorType);
+    bufferTemplate.entries.push_back(entry);
+  }
+  return bufferTemplate;
+}
+
+void DescriptorBufferTemplate::write(
+    VkDevice device, const DescriptorBufferDevice &descriptorBuffers,
+    const DescriptorBufferSet &set,
+    const VkDescriptorBufferInfo *infos) const {
+  for (size_t i = 0; i < entries.size(); i++) {
+    const Entry &entry = entries[i];
+
+    VkBufferDeviceAddressInfo bufferAddress = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+    bufferAddress.buffer = infos[i].buffer;
+    VkDescriptorAddressInfoEXT addressInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT};
+    addressInfo.address =
+        vkGetBufferDeviceAddress(device, &bufferAddress) + infos[i].offset;
+    addressInfo.range = infos[i].range;
+
+    VkDescriptorGetInfoEXT info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT};
+    info.type = entry.type;
+    if (entry.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+      info.data.pUniformBuffer = &addressInfo;
+    } else {
+      info.data.pStorageBuffer = &addressInfo;
+    }
+    descriptorBuffers.getDescriptor(device, &info, entry.size,
+                                    set.data + entry.offset);
+  }
+}
+
+void DescriptorUpdateTemplate::destroy(VkDevice device) {
+  vkDestroyDescriptorUpdateTemplate(device, handle, nullptr);
+  handle = VK_NULL_HANDLE;
+  dataSize = 0;
+}
+
 void DescriptorAllocator::init_pool(VkDevice device, uint32_t maxSets,
                                     std::span<PoolSizeRatio> poolRatios) {
   std::vector<VkDescriptorPoolSize> poolSizes;
@@ -76,44 +230,25 @@ VkDescriptorSet DescriptorAllocator::allocate(VkDevice device,
   return ds;
 }
 
-VkDescriptorPool DescriptorAllocatorGrowable::get_pool(VkDevice device) {
-  VkDescriptorPool newPool;
-  if (readyPools.size() != 0) {
-    newPool = readyPools.back();
-    readyPools.pop_back();
-  } else {
-    // need to create a new pool
-    newPool = create_pool(device, setsPerPool, ratios);
-
-    setsPerPool = static_cast<uint32_t>(setsPerPool * 1.5);
-    if (setsPerPool > 4092) {
-      setsPerPool = static_cast<uint32_t>(4092);
+// adds count descriptors of type to sizes
+static void add_descriptors(std::vector<VkDescriptorPoolSize> &sizes,
+                            VkDescriptorType type, uint32_t count) {
+  for (VkDescriptorPoolSize &size : sizes) {
+    if (size.type == type) {
+      size.descriptorCount += count;
+      return;
     }
   }
-
-  return newPool;
+  sizes.push_back({type, count});
 }
 
-VkDescriptorPool
-DescriptorAllocatorGrowable::create_pool(VkDevice device, uint32_t setCount,
-                                         std::span<PoolSizeRatio> poolRatios) {
-  std::vector<VkDescriptorPoolSize> poolSizes;
-  for (PoolSizeRatio ratio : poolRatios) {
-    poolSizes.push_back(VkDescriptorPoolSize{
-        .type = ratio.type,
-        .descriptorCount = uint32_t(ratio.ratio * setCount)});
+static uint32_t
+descriptor_total(const std::vector<VkDescriptorPoolSize> &sizes) {
+  uint32_t total = 0;
+  for (const VkDescriptorPoolSize &size : sizes) {
+    total += size.descriptorCount;
   }
-
-  VkDescriptorPoolCreateInfo pool_info = {};
-  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pool_info.flags = 0;
-  pool_info.maxSets = setCount;
-  pool_info.poolSizeCount = (uint32_t)poolSizes.size();
-  pool_info.pPoolSizes = poolSizes.data();
-
-  VkDescriptorPool newPool;
-  vkCreateDescriptorPool(device, &pool_info, nullptr, &newPool);
-  return newPool;
+  return total;
 }
 
 void DescriptorAllocatorGrowable::init(VkDevice device, uint32_t maxSets,
@@ -131,15 +266,45 @@ void DescriptorAllocatorGrowable::init(VkDevice device, uint32_t maxSets,
   readyPools.push_back(newPool);
 }
 
+void DescriptorAllocatorGrowable::init_lazy(
+    uint32_t initialSets, std::span<PoolSizeRatio> poolRatios) {
+  ratios.assign(poolRatios.begin(), poolRatios.end());
+  // get_pool creates the first pool with this many sets
+  setsPerPool = initialSets;
+}
+
 void DescriptorAllocatorGrowable::clear_pools(VkDevice device) {
-  for (auto p : readyPools) {
-    vkResetDescriptorPool(device, p, 0);
-  }
-  for (auto p : fullPools) {
-    vkResetDescriptorPool(device, p, 0);
-    readyPools.push_back(p);
+  counters.sets = windowSets;
+  counters.descriptors = descriptor_total(windowDescriptors);
+
+  // the gpu is done with every set, so the pools can be replaced. only
+  // windows that allocated anything say what the pools should hold
+  bool overReserved =
+      reservedSets > 4 * windowSets ||
+      descriptor_total(reservedDescriptors) > 4 * counters.descriptors;
+  if (windowSets > 0 && windowUnknownSets == 0 &&
+      (windowFallthroughs > 0 || overReserved)) {
+    fit_ratios();
+    rebuild(device);
+  } else if (ratiosChanged) {
+    rebuild(device);
+  } else {
+    for (auto p : readyPools) {
+      vkResetDescriptorPool(device, p, 0);
+    }
+    for (auto p : fullPools) {
+      vkResetDescriptorPool(device, p, 0);
+      readyPools.push_back(p);
+    }
+    fullPools.clear();
   }
-  fullPools.clear();
+
+  windowSets = 0;
+  windowUnknownSets = 0;
+  windowFallthroughs = 0;
+  windowDescriptors.clear();
+  // a destroyed layout's handle may come back for a new layout
+  layoutCache.clear();
 }
 
 void DescriptorAllocatorGrowable::destroy_pools(VkDevice device) {
@@ -151,10 +316,29 @@ void DescriptorAllocatorGrowable::destroy_pools(VkDevice device) {
     vkDestroyDescriptorPool(device, p, nullptr);
   }
   fullPools.clear();
+  reservedSets = 0;
+  reservedDescriptors.clear();
+}
+
+const std::vector<VkDescriptorPoolSize> *
+DescriptorAllocatorGrowable::layout_sizes(VkDescriptorSetLayout layout) {
+  for (const CachedLayout &cached : layoutCache) {
+    if (cached.layout == layout) {
+      return cached.known ? &cached.sizes : nullptr;
+    }
+  }
+
+  CachedLayout &cached = layoutCache.emplace_back();
+  cached.layout = layout;
+  cached.known = descriptor_layout_sizes(layout, cached.sizes);
+  return cached.known ? &cached.sizes : nullptr;
 }
 
 VkDescriptorSet DescriptorAllocatorGrowable::allocate(
     VkDevice device, VkDescriptorSetLayout layout, void *pNext) {
+  const std::vector<VkDescriptorPoolSize> *layoutSizes =
+      layout_sizes(layout);
+
   // get or create a pool to allocate from
   VkDescriptorPool poolToUse = get_pool(device);
 
@@ -171,19 +355,185 @@ VkDescriptorSet DescriptorAllocatorGrowable::allocate(
   // allocation failed. Try again
   if (result == VK_ERROR_OUT_OF_POOL_MEMORY ||
       result == VK_ERROR_FRAGMENTED_POOL) {
+    counters.fallthroughs++;
+    windowFallthroughs++;
+    if (result == VK_ERROR_FRAGMENTED_POOL) {
+      counters.fragmentedFailures++;
+    }
 
     fullPools.push_back(poolToUse);
 
     poolToUse = get_pool(device);
     allocInfo.descriptorPool = poolToUse;
-
-    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &ds));
+    result = vkAllocateDescriptorSets(device, &allocInfo, &ds);
+
+    // the ratios were tuned to windows that didn't use this layout's types.
+    // make room for them and give the set a pool of its own
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY && layoutSizes) {
+      for (const VkDescriptorPoolSize &size : *layoutSizes) {
+        bool found = false;
+        for (PoolSizeRatio &ratio : ratios) {
+          if (ratio.type == size.type) {
+            ratio.ratio = std::max(ratio.ratio, float(size.descriptorCount));
+            found = true;
+          }
+        }
+        if (!found) {
+          ratios.push_back({size.type, float(size.descriptorCount)});
+        }
+      }
+
+      // the ready pools were made with the old ratios, nothing more is
+      // allocated from them until clear_pools rebuilds the pools
+      fullPools.push_back(poolToUse);
+      fullPools.insert(fullPools.end(), readyPools.begin(), readyPools.end());
+      readyPools.clear();
+      ratiosChanged = true;
+
+      poolToUse = create_pool(device, setsPerPool, ratios);
+      allocInfo.descriptorPool = poolToUse;
+      result = vkAllocateDescriptorSets(device, &allocInfo, &ds);
+    }
+    VK_CHECK(result);
   }
 
   readyPools.push_back(poolToUse);
+
+  windowSets++;
+  if (layoutSizes) {
+    for (const VkDescriptorPoolSize &size : *layoutSizes) {
+      add_descriptors(windowDescriptors, size.type, size.descriptorCount);
+    }
+  } else {
+    windowUnknownSets++;
+  }
   return ds;
 }
 
+DescriptorAllocatorGrowable::Stats DescriptorAllocatorGrowable::stats() const {
+  Stats stats = counters;
+  stats.pools = static_cast<uint32_t>(readyPools.size() + fullPools.size());
+  stats.reservedSets = reservedSets;
+  stats.reservedDescriptors = descriptor_total(reservedDescriptors);
+  return stats;
+}
+
+void DescriptorAllocatorGrowable::Stats::add(const Stats &other) {
+  pools += other.pools;
+  fallthroughs += other.fallthroughs;
+  fragmentedFailures += other.fragmentedFailures;
+  retunes += other.retunes;
+  sets += other.sets;
+  descriptors += other.descriptors;
+  reservedSets += other.reservedSets;
+  reservedDescriptors += other.reservedDescriptors;
+}
+
+VkDescriptorPool DescriptorAllocatorGrowable::get_pool(VkDevice device) {
+  VkDescriptorPool newPool;
+  if (readyPools.size() != 0) {
+    newPool = readyPools.back();
+    readyPools.pop_back();
+  } else {
+    // need to create a new pool
+    newPool = create_pool(device, setsPerPool, ratios);
+
+    setsPerPool = static_cast<uint32_t>(setsPerPool * 1.5);
+    if (setsPerPool > 4092) {
+      setsPerPool = static_cast<uint32_t>(4092);
+    }
+  }
+
+  return newPool;
+}
+
+VkDescriptorPool
+DescriptorAllocatorGrowable::create_pool(VkDevice device, uint32_t setCount,
+                                         std::span<PoolSizeRatio> poolRatios) {
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (PoolSizeRatio ratio : poolRatios) {
+    // a type the pools hold is kept, however rarely it gets used
+    uint32_t count = std::max(1u, uint32_t(ratio.ratio * setCount));
+    poolSizes.push_back(
+        VkDescriptorPoolSize{.type = ratio.type, .descriptorCount = count});
+    add_descriptors(reservedDescriptors, ratio.type, count);
+  }
+  reservedSets += setCount;
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags = 0;
+  pool_info.maxSets = setCount;
+  pool_info.poolSizeCount = (uint32_t)poolSizes.size();
+  pool_info.pPoolSizes = poolSizes.data();
+
+  VkDescriptorPool newPool;
+  VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &newPool));
+  return newPool;
+}
+
+void DescriptorAllocatorGrowable::fit_ratios() {
+  // the ratios follow what the window used, and only halve for the types
+  // it used less of, so an occasional frame doesn't throw them away
+  for (PoolSizeRatio &ratio : ratios) {
+    ratio.ratio *= 0.5f;
+  }
+  for (const VkDescriptorPoolSize &size : windowDescriptors) {
+    float observed = float(size.descriptorCount) / windowSets;
+    bool found = false;
+    for (PoolSizeRatio &ratio : ratios) {
+      if (ratio.type == size.type) {
+        ratio.ratio = std::max(ratio.ratio, observed);
+        found = true;
+      }
+    }
+    if (!found) {
+      ratios.push_back({size.type, observed});
+    }
+  }
+}
+
+void DescriptorAllocatorGrowable::rebuild(VkDevice device) {
+  destroy_pools(device);
+
+  // a quarter of headroom over the window, in one pool
+  uint32_t setCount = windowSets + windowSets / 4 + 1;
+  readyPools.push_back(create_pool(device, setCount, ratios));
+  setsPerPool = static_cast<uint32_t>(setCount * 1.5);
+  ratiosChanged = false;
+  counters.retunes++;
+}
+
+DescriptorAllocatorGrowable::Stats DescriptorAllocatorPerThread::stats() const {
+  DescriptorAllocatorGrowable::Stats total;
+  for (const DescriptorAllocatorGrowable &allocator : allocators) {
+    total.add(allocator.stats());
+  }
+  return total;
+}
+
+void DescriptorAllocatorPerThread::init(
+    VkDevice device, uint32_t threadCount, uint32_t initialSets,
+    std::span<DescriptorAllocatorGrowable::PoolSizeRatio> poolRatios) {
+  allocators.resize(threadCount);
+  allocators[0].init(device, initialSets, poolRatios);
+  for (uint32_t i = 1; i < threadCount; i++) {
+    allocators[i].init_lazy(std::max(initialSets / 16, 16u), poolRatios);
+  }
+}
+
+void DescriptorAllocatorPerThread::clear_pools(VkDevice device) {
+  for (DescriptorAllocatorGrowable &allocator : allocators) {
+    allocator.clear_pools(device);
+  }
+}
+
+void DescriptorAllocatorPerThread::destroy_pools(VkDevice device) {
+  for (DescriptorAllocatorGrowable &allocator : allocators) {
+    allocator.destroy_pools(device);
+  }
+}
+
 void DescriptorWriter::write_buffer(int binding, VkBuffer buffer, size_t size,
                                     size_t offset, VkDescriptorType type) {
   VkDescriptorBufferInfo &info =
@@ -234,3 +584,223 @@ void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set) {
   vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0,
                          nullptr);
 }
+
+void DescriptorWriter::update_buffer(
+    VkDevice device, const DescriptorBufferDevice &descriptorBuffers,
+    const DescriptorBufferSet &set) {
+  for (const VkWriteDescriptorSet &write : writes) {
+    VkDeviceSize offset;
+    descriptorBuffers.getBindingOffset(device, set.layout, write.dstBinding,
+                                       &offset);
+    size_t size = descriptorBuffers.descriptor_size(write.descriptorType);
+    offset += write.dstArrayElement * size;
+
+    VkDescriptorGetInfoEXT info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT};
+    info.type = write.descriptorType;
+
+    VkDescriptorAddressInfoEXT addressInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT};
+    if (write.pBufferInfo) {
+      VkBufferDeviceAddressInfo bufferAddress = {
+          .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+      bufferAddress.buffer = write.pBufferInfo->buffer;
+      addressInfo.address = vkGetBufferDeviceAddress(device, &bufferAddress) +
+                            write.pBufferInfo->offset;
+      addressInfo.range = write.pBufferInfo->range;
+    }
+
+    switch (write.descriptorType) {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      info.data.pUniformBuffer = &addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      info.data.pStorageBuffer = &addressInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      info.data.pCombinedImageSampler = write.pImageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      info.data.pSampledImage = write.pImageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      info.data.pStorageImage = write.pImageInfo;
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+      info.data.pSampler = &write.pImageInfo->sampler;
+      break;
+    default:
+      fmt::println("descriptor type {} can't be written to a descriptor "
+                   "buffer",
+                   string_VkDescriptorType(write.descriptorType));
+      abort();
+    }
+
+    descriptorBuffers.getDescriptor(device, &info, size, set.data + offset);
+  }
+}
+
+bool DescriptorBufferDevice::supported(VkPhysicalDevice physicalDevice,
+                                       VkDeviceSize frameBufferSize,
+                                       uint32_t frameBufferCount,
+                                       uint32_t heapImages,
+                                       uint32_t heapSamplers) {
+  uint32_t count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       extensions.data());
+  bool extension = false;
+  for (const VkExtensionProperties &properties : extensions) {
+    if (strcmp(properties.extensionName,
+               VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) == 0) {
+      extension = true;
+    }
+  }
+  if (!extension) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT};
+  VkPhysicalDeviceFeatures2 features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  features.pNext = &descriptorBufferFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  if (!descriptorBufferFeatures.descriptorBuffer) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorBufferPropertiesEXT limits = {
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT};
+  VkPhysicalDeviceProperties2 properties = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  properties.pNext = &limits;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+  // the spec only guarantees one resource buffer binding, the geometry pass
+  // binds the frame buffer and the heap
+  if (limits.maxDescriptorBufferBindings < 2 ||
+      limits.maxResourceDescriptorBufferBindings < 2 ||
+      limits.maxSamplerDescriptorBufferBindings < 1) {
+    return false;
+  }
+
+  // the heap's layout size is only known once the device exists. the sum
+  // of its descriptors, plus an alignment of padding, bounds it
+  VkDeviceSize heapSize =
+      VkDeviceSize(heapImages) * limits.sampledImageDescriptorSize +
+      VkDeviceSize(heapSamplers) * limits.samplerDescriptorSize +
+      limits.descriptorBufferOffsetAlignment;
+  VkDeviceSize resourceSpace = heapSize + frameBufferSize * frameBufferCount;
+  return heapSize <= limits.maxSamplerDescriptorBufferRange &&
+         heapSize <= limits.maxResourceDescriptorBufferRange &&
+         frameBufferSize <= limits.maxResourceDescriptorBufferRange &&
+         heapSize <= limits.samplerDescriptorBufferAddressSpaceSize &&
+         resourceSpace <= limits.resourceDescriptorBufferAddressSpaceSize &&
+         resourceSpace <= limits.descriptorBufferAddressSpaceSize;
+}
+
+void DescriptorBufferDevice::init(VkDevice device,
+                                  VkPhysicalDevice physicalDevice) {
+  getLayoutSize = (PFN_vkGetDescriptorSetLayoutSizeEXT)vkGetDeviceProcAddr(
+      device, "vkGetDescriptorSetLayoutSizeEXT");
+  getBindingOffset =
+      (PFN_vkGetDescriptorSetLayoutBindingOffsetEXT)vkGetDeviceProcAddr(
+          device, "vkGetDescriptorSetLayoutBindingOffsetEXT");
+  getDescriptor = (PFN_vkGetDescriptorEXT)vkGetDeviceProcAddr(
+      device, "vkGetDescriptorEXT");
+  cmdBindBuffers = (PFN_vkCmdBindDescriptorBuffersEXT)vkGetDeviceProcAddr(
+      device, "vkCmdBindDescriptorBuffersEXT");
+  cmdSetOffsets = (PFN_vkCmdSetDescriptorBufferOffsetsEXT)vkGetDeviceProcAddr(
+      device, "vkCmdSetDescriptorBufferOffsetsEXT");
+
+  properties = {
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT};
+  VkPhysicalDeviceProperties2 properties2 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  properties2.pNext = &properties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+}
+
+size_t DescriptorBufferDevice::descriptor_size(VkDescriptorType type) const {
+  switch (type) {
+  case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    return properties.uniformBufferDescriptorSize;
+  case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    return properties.storageBufferDescriptorSize;
+  case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    return properties.combinedImageSamplerDescriptorSize;
+  case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    return properties.sampledImageDescriptorSize;
+  case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    return properties.storageImageDescriptorSize;
+  case VK_DESCRIPTOR_TYPE_SAMPLER:
+    return properties.samplerDescriptorSize;
+  default:
+    return 0;
+  }
+}
+
+void DescriptorBufferAllocator::init(
+    VkDevice device, VmaAllocator allocator,
+    const DescriptorBufferDevice *descriptorBuffers, VkDeviceSize size,
+    VkBufferUsageFlags usage) {
+  this->device = device;
+  this->descriptorBuffers = descriptorBuffers;
+
+  VkBufferCreateInfo bufferInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bufferInfo.size = size;
+  bufferInfo.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+  // written by the cpu, read by the gpu straight from host visible memory
+  VmaAllocationCreateInfo vmaallocInfo = {};
+  vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+  vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaallocInfo,
+                           &buffer.buffer, &buffer.allocation, &buffer.info));
+  buffer.usage = bufferInfo.usage;
+  buffer.size = size;
+
+  VkBufferDeviceAddressInfo addressInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+  addressInfo.buffer = buffer.buffer;
+  address = vkGetBufferDeviceAddress(device, &addressInfo);
+  head = 0;
+}
+
+void DescriptorBufferAllocator::destroy(VmaAllocator allocator) {
+  vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+  buffer = {};
+}
+
+DescriptorBufferSet
+DescriptorBufferAllocator::allocate(VkDescriptorSetLayout layout) {
+  VkDeviceSize size;
+  descriptorBuffers->getLayoutSize(device, layout, &size);
+
+  VkDeviceSize alignment =
+      descriptorBuffers->properties.descriptorBufferOffsetAlignment;
+  VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+  if (offset + size > buffer.size) {
+    fmt::println("descriptor buffer is full ({} bytes)", buffer.size);
+    abort();
+  }
+  head = offset + size;
+
+  return {layout, offset, (uint8_t *)buffer.info.pMappedData + offset};
+}
+
+VkDescriptorBufferBindingInfoEXT
+DescriptorBufferAllocator::binding_info() const {
+  VkDescriptorBufferBindingInfoEXT info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT};
+  info.address = address;
+  info.usage = buffer.usage;
+  return info;
+}
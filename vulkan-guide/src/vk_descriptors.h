@@ -1,7 +1,30 @@
 ﻿#pragma once
 
+#include <cassert>
+#include <type_traits>
+
 #include <vk_types.h>
 
+// writes every binding of a set from one packed struct in a single
+// vkUpdateDescriptorSetWithTemplate call, without the per write records
+// DescriptorWriter builds. the struct holds a VkDescriptorBufferInfo or
+// VkDescriptorImageInfo per descriptor, in the builder's binding order
+struct DescriptorUpdateTemplate {
+  VkDescriptorUpdateTemplate handle{VK_NULL_HANDLE};
+  size_t dataSize{0};
+
+  template <typename T>
+  void update(VkDevice device, VkDescriptorSet set, const T &data) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    assert(sizeof(T) == dataSize);
+    vkUpdateDescriptorSetWithTemplate(device, set, handle, &data);
+  }
+  void destroy(VkDevice device);
+};
+
+struct DescriptorBufferDevice;
+struct DescriptorBufferTemplate;
+
 struct DescriptorLayoutBuilder {
 
   std::vector<VkDescriptorSetLayoutBinding> bindings;
@@ -11,8 +34,21 @@ struct DescriptorLayoutBuilder {
   VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shaderStages,
                               void *pNext = nullptr,
                               VkDescriptorSetLayoutCreateFlags flags = 0);
+  // for sets of the layout build() made from the same bindings. layouts
+  // made for descriptor buffers have no sets to update
+  DescriptorUpdateTemplate build_template(VkDevice device,
+                                          VkDescriptorSetLayout layout) const;
+  // the same for layouts made for descriptor buffers
+  DescriptorBufferTemplate
+  build_buffer_template(VkDevice device, VkDescriptorSetLayout layout,
+                        const DescriptorBufferDevice &descriptorBuffers) const;
 };
 
+// build() records the descriptor counts of every layout for the allocators'
+// usage tracking. call this before destroying a layout it built, a new
+// layout that gets the same handle must not inherit the counts
+void unregister_descriptor_layout(VkDescriptorSetLayout layout);
+
 struct DescriptorAllocator {
 
   struct PoolSizeRatio {
@@ -30,6 +66,12 @@ struct DescriptorAllocator {
   VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
 };
 
+// not thread safe, threads that allocate side by side use their own
+// instance, see DescriptorAllocatorPerThread. the pools tune themselves to
+// what gets allocated from layouts DescriptorLayoutBuilder built: when the
+// sets handed out since the last clear_pools fell through to new pools, or
+// used less than a quarter of what the pools hold, clear_pools replaces
+// the pools with one sized for that usage
 struct DescriptorAllocatorGrowable {
 public:
   struct PoolSizeRatio {
@@ -37,23 +79,187 @@ public:
     float ratio;
   };
 
+  struct Stats {
+    uint32_t pools{0};
+    // allocations that failed on one pool and went on to another
+    uint64_t fallthroughs{0};
+    // the failures that were fragmentation rather than a full pool
+    uint64_t fragmentedFailures{0};
+    // times clear_pools replaced the pools with ones made for the usage
+    uint64_t retunes{0};
+    // handed out between the last two clear_pools
+    uint32_t sets{0};
+    uint32_t descriptors{0};
+    // what the pools hold
+    uint32_t reservedSets{0};
+    uint32_t reservedDescriptors{0};
+
+    void add(const Stats &other);
+  };
+
   void init(VkDevice device, uint32_t initialSets,
             std::span<PoolSizeRatio> poolRatios);
+  // like init, but the first pool is only created by the first allocate
+  void init_lazy(uint32_t initialSets, std::span<PoolSizeRatio> poolRatios);
   void clear_pools(VkDevice device);
   void destroy_pools(VkDevice device);
 
   VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout,
                            void *pNext = nullptr);
 
+  Stats stats() const;
+
 private:
   VkDescriptorPool get_pool(VkDevice device);
   VkDescriptorPool create_pool(VkDevice device, uint32_t setCount,
                                std::span<PoolSizeRatio> poolRatios);
+  // moves the ratios toward what the last clear_pools window used
+  void fit_ratios();
+  // replaces every pool with one that fits the last clear_pools window,
+  // made with the current ratios
+  void rebuild(VkDevice device);
+  // the layout's descriptor counts, null if the builder didn't make it.
+  // only the first lookup of a layout since clear_pools reads the registry
+  const std::vector<VkDescriptorPoolSize> *
+  layout_sizes(VkDescriptorSetLayout layout);
 
   std::vector<PoolSizeRatio> ratios;
   std::vector<VkDescriptorPool> fullPools;
   std::vector<VkDescriptorPool> readyPools;
   uint32_t setsPerPool;
+  // allocate raised the ratios, the pools made before don't follow them
+  bool ratiosChanged{false};
+
+  // since the last clear_pools. sets from layouts the builder didn't make
+  // have no known descriptor counts, they keep the pools from retuning
+  uint32_t windowSets{0};
+  uint32_t windowUnknownSets{0};
+  uint32_t windowFallthroughs{0};
+  std::vector<VkDescriptorPoolSize> windowDescriptors;
+
+  std::vector<VkDescriptorPoolSize> reservedDescriptors;
+  uint32_t reservedSets{0};
+  Stats counters;
+
+  // the few layouts this allocator hands out sets for, scanned in order
+  struct CachedLayout {
+    VkDescriptorSetLayout layout;
+    bool known;
+    std::vector<VkDescriptorPoolSize> sizes;
+  };
+  std::vector<CachedLayout> layoutCache;
+};
+
+// one DescriptorAllocatorGrowable per job system thread, so jobs recording
+// or loading side by side allocate without locking. a thread only touches
+// the allocator of its own index, clear_pools and destroy_pools run while
+// nothing allocates
+struct DescriptorAllocatorPerThread {
+public:
+  // thread 0 starts with a pool of initialSets. the other threads create
+  // theirs on their first allocation, with a sixteenth of that, and grow
+  // or tune from there. threads that never allocate hold no pools
+  void init(VkDevice device, uint32_t threadCount, uint32_t initialSets,
+            std::span<DescriptorAllocatorGrowable::PoolSizeRatio> poolRatios);
+  void clear_pools(VkDevice device);
+  void destroy_pools(VkDevice device);
+
+  DescriptorAllocatorGrowable &for_thread(uint32_t threadIndex) {
+    return allocators[threadIndex];
+  }
+
+  // summed over the threads
+  DescriptorAllocatorGrowable::Stats stats() const;
+
+private:
+  std::vector<DescriptorAllocatorGrowable> allocators;
+};
+
+// the VK_EXT_descriptor_buffer entry points and descriptor sizes. the
+// loader doesn't export extension functions, they come from the device
+struct DescriptorBufferDevice {
+  PFN_vkGetDescriptorSetLayoutSizeEXT getLayoutSize{nullptr};
+  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT getBindingOffset{nullptr};
+  PFN_vkGetDescriptorEXT getDescriptor{nullptr};
+  PFN_vkCmdBindDescriptorBuffersEXT cmdBindBuffers{nullptr};
+  PFN_vkCmdSetDescriptorBufferOffsetsEXT cmdSetOffsets{nullptr};
+  VkPhysicalDeviceDescriptorBufferPropertiesEXT properties{};
+
+  // the device has the extension and its descriptorBuffer feature, and its
+  // limits allow binding one of frameBufferCount resource buffers of
+  // frameBufferSize next to a bindless heap of heapImages sampled images
+  // and heapSamplers samplers, which is a resource and a sampler buffer
+  static bool supported(VkPhysicalDevice physicalDevice,
+                        VkDeviceSize frameBufferSize, uint32_t frameBufferCount,
+                        uint32_t heapImages, uint32_t heapSamplers);
+  void init(VkDevice device, VkPhysicalDevice physicalDevice);
+
+  size_t descriptor_size(VkDescriptorType type) const;
+};
+
+// a set laid out in a descriptor buffer, bound by its offset
+struct DescriptorBufferSet {
+  VkDescriptorSetLayout layout;
+  VkDeviceSize offset;
+  // the host address of offset
+  uint8_t *data;
+};
+
+// the descriptor buffer counterpart of DescriptorAllocatorGrowable: sets
+// are bump allocated from a host visible buffer and written in place, no
+// pools and no vkUpdateDescriptorSets. clear() hands out the whole buffer
+// again, the gpu has to be done with it. the buffer doesn't grow, running
+// out of it aborts
+struct DescriptorBufferAllocator {
+public:
+  // usage is RESOURCE_DESCRIPTOR_BUFFER and or SAMPLER_DESCRIPTOR_BUFFER,
+  // layouts have to be created with DESCRIPTOR_BUFFER_BIT
+  void init(VkDevice device, VmaAllocator allocator,
+            const DescriptorBufferDevice *descriptorBuffers, VkDeviceSize size,
+            VkBufferUsageFlags usage);
+  void destroy(VmaAllocator allocator);
+  void clear() { head = 0; }
+
+  DescriptorBufferSet allocate(VkDescriptorSetLayout layout);
+
+  // to bind the buffer with vkCmdBindDescriptorBuffersEXT
+  VkDescriptorBufferBindingInfoEXT binding_info() const;
+  VkDeviceSize used() const { return head; }
+
+private:
+  VkDevice device{VK_NULL_HANDLE};
+  const DescriptorBufferDevice *descriptorBuffers{nullptr};
+  AllocatedBuffer buffer{};
+  VkDeviceAddress address{0};
+  VkDeviceSize head{0};
+};
+
+// the descriptor buffer counterpart of DescriptorUpdateTemplate, for sets
+// of single buffer descriptors. binding offsets and descriptor sizes are
+// looked up once per layout, update() writes each descriptor in place with
+// vkGetDescriptorEXT. the struct holds a VkDescriptorBufferInfo per
+// binding, in the builder's binding order, and the buffers need
+// SHADER_DEVICE_ADDRESS usage
+struct DescriptorBufferTemplate {
+  struct Entry {
+    VkDescriptorType type;
+    // into the set
+    VkDeviceSize offset;
+    size_t size;
+  };
+  std::vector<Entry> entries;
+
+  template <typename T>
+  void update(VkDevice device, const DescriptorBufferDevice &descriptorBuffers,
+              const DescriptorBufferSet &set, const T &data) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    assert(sizeof(T) == entries.size() * sizeof(VkDescriptorBufferInfo));
+    write(device, descriptorBuffers, set,
+          reinterpret_cast<const VkDescriptorBufferInfo *>(&data));
+  }
+  void write(VkDevice device, const DescriptorBufferDevice &descriptorBuffers,
+             const DescriptorBufferSet &set,
+             const VkDescriptorBufferInfo *infos) const;
 };
 
 struct DescriptorWriter {
@@ -68,4 +274,9 @@ struct DescriptorWriter {
 
   void clear();
   void update_set(VkDevice device, VkDescriptorSet set);
+  // the same writes, straight into a descriptor buffer. buffers are
+  // referenced by device address, they need SHADER_DEVICE_ADDRESS usage
+  void update_buffer(VkDevice device,
+                     const DescriptorBufferDevice &descriptorBuffers,
+                     const DescriptorBufferSet &set);
 };
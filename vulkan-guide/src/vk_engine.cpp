@@ -10,6 +10,7 @@
 #include <vk_types.h>
 
 #include <chrono>
+#include <fstream>
 #include <thread>
 
 #include <VkBootstrap.h>
@@ -18,11 +19,14 @@
 #include "vk_mem_alloc.h"
 
 #include <vk_pipelines.h>
+#include <vk_profiler.h>
+#include <vk_stats.h>
 
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
 #include "imgui_impl_vulkan.h"
 
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/transform.hpp>
 
 VulkanEngine *loadedEngine = nullptr;
@@ -30,19 +34,28 @@ VulkanEngine *loadedEngine = nullptr;
 VulkanEngine &VulkanEngine::Get() { return *loadedEngine; }
 
 void VulkanEngine::init() {
+  PROFILE_FUNCTION();
   // only one engine initialization is allowed with the application.
   assert(loadedEngine == nullptr);
   loadedEngine = this;
 
-  // We initialize SDL and create a window with it.
-  SDL_Init(SDL_INIT_VIDEO);
+#ifdef ENGINE_PROFILING
+  profiler::set_thread_name("main");
+#endif
 
-  SDL_WindowFlags window_flags =
-      (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+  _jobs.init();
 
-  _window = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
-                             SDL_WINDOWPOS_UNDEFINED, _drawExtent.width,
-                             _drawExtent.height, window_flags);
+  if (!_headless) {
+    // We initialize SDL and create a window with it.
+    SDL_Init(SDL_INIT_VIDEO);
+
+    SDL_WindowFlags window_flags =
+        (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+
+    _window = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
+                               SDL_WINDOWPOS_UNDEFINED, _drawExtent.width,
+                               _drawExtent.height, window_flags);
+  }
 
   init_vulkan();
 
@@ -56,10 +69,19 @@ void VulkanEngine::init() {
 
   init_pipelines();
 
-  init_imgui();
+  // imgui needs a window to read input from and a swapchain to draw into
+  if (!_headless) {
+    init_imgui();
+  }
 
   init_default_data();
 
+  // what init uploaded is drawn from the first frame on, which acquires
+  // every upload finished by then
+  _uploads.wait_all();
+
+  set_record_threads(MAX_RECORD_THREADS);
+
   mainCamera.velocity = glm::vec3(0.f);
   mainCamera.position = glm::vec3(0, 0, 5);
 
@@ -76,37 +98,63 @@ void VulkanEngine::cleanup() {
     // make sure the gpu has stopped doing its things
     vkDeviceWaitIdle(_device);
 
+    _jobs.shutdown();
+
     // free per-frame structures and deletion queue
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
       vkDestroyCommandPool(_device, _frames[i]._commandPool, nullptr);
+      for (int t = 0; t < MAX_RECORD_THREADS; t++) {
+        vkDestroyCommandPool(_device, _frames[i]._recordPools[t], nullptr);
+      }
+      vkDestroyQueryPool(_device, _frames[i]._timestamps.pool, nullptr);
+      vkDestroyQueryPool(_device, _frames[i]._statistics.pool, nullptr);
+      vkDestroyCommandPool(_device, _frames[i]._computePool, nullptr);
+      vkDestroyQueryPool(_device, _frames[i]._computeTimestamps.pool, nullptr);
+      if (_headless && _headlessReadback) {
+        destroy_buffer(_frames[i]._readbackBuffer);
+      }
 
       // destroy sync objects
-      vkDestroyFence(_device, _frames[i]._renderFence, nullptr);
       vkDestroySemaphore(_device, _frames[i]._renderSemaphore, nullptr);
       vkDestroySemaphore(_device, _frames[i]._swapchainSemaphore, nullptr);
-
-      _frames[i]._deletionQueue.flush();
     }
 
+    // the moved allocations have to outlive the pass, so it ends first
+    _defragmenter.cleanup();
+    // the device is idle, whatever was retired can go
+    _retirement.flush();
+
+    // the meshes' ranges go back to the geometry pool, which releases the
+    // blocks they emptied
     for (auto &mesh : testMeshes) {
-      destroy_buffer(mesh->meshBuffers.indexBuffer);
-      destroy_buffer(mesh->meshBuffers.vertexBuffer);
+      destroy_mesh(mesh->meshBuffers);
     }
+    testMeshes.clear();
+    _geometry.collect(_retirement.submitted_value());
+
+    vkDestroySemaphore(_device, _frameTimeline, nullptr);
+    vkDestroySemaphore(_device, _computeTimeline, nullptr);
 
     metalRoughMaterial.clear_resources(_device);
 
     // flush the global deletion queue
     _mainDeletionQueue.flush();
 
-    destroy_swapchain();
+    _retirement.report_leaks();
 
-    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    if (!_headless) {
+      destroy_swapchain();
+
+      vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    }
     vkDestroyDevice(_device, nullptr);
 
     vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
     vkDestroyInstance(_instance, nullptr);
-    SDL_DestroyWindow(_window);
+    if (_window) {
+      SDL_DestroyWindow(_window);
+    }
   }
 
   // clear engine pointer
@@ -114,27 +162,63 @@ void VulkanEngine::cleanup() {
 }
 
 void VulkanEngine::draw() {
-
+  PROFILE_FUNCTION();
+  // wait until the gpu has finished the last frame that used this slot
+  auto waitStart = std::chrono::high_resolution_clock::now();
+  wait_frame_timeline(get_current_frame()._timelineValue);
+  _lastFrameWaitMs = std::chrono::duration<double, std::milli>(
+                         std::chrono::high_resolution_clock::now() - waitStart)
+                         .count();
+  _presentStats.frameWait.push(_lastFrameWaitMs);
+
+  // update the scene after the wait so the camera is as recent as possible
   update_scene();
 
-  // wait until the gpu has finished rendering the last frame. Timeout of 1
-  // second
-  VK_CHECK(vkWaitForFences(_device, 1, &get_current_frame()._renderFence, true,
-                           1000000000));
+  _memoryTelemetry.update(static_cast<uint32_t>(_frameNumber));
 
-  get_current_frame()._deletionQueue.flush();
+  // the timeline passed this slot's value, and maybe newer ones. whatever
+  // was retired before those frames were submitted is unused
+  uint64_t completedValue;
+  VK_CHECK(
+      vkGetSemaphoreCounterValue(_device, _frameTimeline, &completedValue));
+  _defragmenter.collect(completedValue);
+  _retirement.collect(completedValue);
+  _bindless.collect(completedValue);
+  _geometry.collect(completedValue);
   get_current_frame()._frameDescriptors.clear_pools(_device);
+  get_current_frame()._frameDescriptorBuffer.clear();
+  get_current_frame()._frameAllocator.reset();
+  uint64_t bufferAllocationsAtStart = _bufferAllocations;
+
+  // same for the secondary command buffers the slot recorded
+  for (uint32_t i = 0; i < get_current_frame()._recordBuffersUsed; i++) {
+    VK_CHECK(vkResetCommandPool(
+        _device, get_current_frame()._recordPools[i], 0));
+  }
+  get_current_frame()._recordBuffersUsed = 0;
+
+  // the frame this slot was last used for is done, so its timestamps are ready
+  read_frame_timestamps(get_current_frame());
 
-  VK_CHECK(vkResetFences(_device, 1, &get_current_frame()._renderFence));
+  // the value this frame's submit will signal on the frame timeline
+  uint64_t frameTimelineValue = static_cast<uint64_t>(_frameNumber) + 1;
 
   // request image from the swapchain
-  uint32_t swapchainImageIndex;
-  VkResult e = vkAcquireNextImageKHR(_device, _swapchain, 1000000000,
-                                     get_current_frame()._swapchainSemaphore,
-                                     nullptr, &swapchainImageIndex);
-  if (e == VK_ERROR_OUT_OF_DATE_KHR) {
-    resize_requested = true;
-    return;
+  uint32_t swapchainImageIndex = 0;
+  if (!_headless) {
+    PROFILE_ZONE("acquire");
+    auto acquireStart = std::chrono::high_resolution_clock::now();
+    VkResult e = vkAcquireNextImageKHR(_device, _swapchain, 1000000000,
+                                       get_current_frame()._swapchainSemaphore,
+                                       nullptr, &swapchainImageIndex);
+    _presentStats.acquireWait.push(
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - acquireStart)
+            .count());
+    if (e == VK_ERROR_OUT_OF_DATE_KHR) {
+      resize_requested = true;
+      return;
+    }
   }
 
   // naming it cmd for shorter writing
@@ -149,57 +233,184 @@ void VulkanEngine::draw() {
   VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(
       VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-  _drawExtent.height = static_cast<uint32_t>(
-      std::min(_swapchainExtent.height, _drawImage.imageExtent.height) *
-      renderScale);
+  VkExtent2D scaledExtent = {
+      static_cast<uint32_t>(_swapchainExtent.width * renderScale),
+      static_cast<uint32_t>(_swapchainExtent.height * renderScale)};
+
+  // reallocate the draw targets when the window or render scale outgrew them
+  resize_draw_targets(scaledExtent);
 
-  _drawExtent.width = static_cast<uint32_t>(
-      std::min(_swapchainExtent.width, _drawImage.imageExtent.width) *
-      renderScale);
+  _drawExtent.height =
+      std::min(scaledExtent.height, _drawImage.imageExtent.height);
+  _drawExtent.width =
+      std::min(scaledExtent.width, _drawImage.imageExtent.width);
+
+  if (_asyncCompute) {
+    // the previous frame may still render into the draw image, draw into the
+    // other one while its background runs on the compute queue
+    std::swap(_drawImage, _backDrawImage);
+    std::swap(_drawImageDescriptors, _backDrawImageDescriptors);
+    submit_async_background(frameTimelineValue);
+  }
 
   VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-  // transition our main draw image into general layout so we can write into it
-  // we will overwrite it all so we dont care about what was the older layout
-  vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_GENERAL);
+  GpuTimestampQueries &timestamps = get_current_frame()._timestamps;
+  timestamps.begin_frame(cmd);
+  get_current_frame()._statistics.begin_frame(cmd);
+
+  // send off what was uploaded since the last frame in one batch, and take
+  // ownership of the uploads that finished
+  _uploads.flush();
+  uint64_t uploadWaitValue = _uploads.acquire_finished(cmd);
+
+  // move a bounded amount of pooled memory, before the draws look up the
+  // moved resources
+  check_fragmentation();
+  _defragmenter.step(cmd, frameTimelineValue,
+                     [this](const VmaDefragmentationMove &move,
+                            VkCommandBuffer copyCmd) {
+                       return move_allocation(move, copyCmd);
+                     });
+
+  // materials written since the last frame
+  _materialTable.flush(cmd);
+
+  // the frame waits for its async background and for the uploads it
+  // acquired, those have finished already
+  VkSemaphoreSubmitInfo waitInfos[3];
+  uint32_t waitCount = 0;
+  if (_asyncCompute) {
+    waitInfos[waitCount++] = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, _computeTimeline,
+        frameTimelineValue);
+  }
+  if (uploadWaitValue != 0) {
+    waitInfos[waitCount++] = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _uploads.timeline(),
+        uploadWaitValue);
+  }
+
+  timestamps.begin_pass(cmd, GpuPass::Frame);
+
+  // the passes declare what they use, the graph places the layout
+  // transitions and barriers between them. the draw targets are fully
+  // overwritten every frame, so they start out UNDEFINED
+  _renderGraph.reset();
+  RGResource drawImage;
+  if (_asyncCompute) {
+    // the compute queue already drew the background, the submit waits for
+    // it at color attachment output
+    drawImage = _renderGraph.import_image(
+        "draw image", _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_GENERAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+  } else {
+    drawImage = _renderGraph.import_image(
+        "draw image", _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+    _renderGraph.add_pass(
+        "background", {{drawImage, ResourceUsage::ComputeStorageWrite}},
+        [&](VkCommandBuffer cmd) {
+          draw_background(cmd, timestamps, get_current_frame()._statistics);
+        });
+  }
+  RGResource depthImage = _renderGraph.create_image(
+      "depth image",
+      {_depthFormat,
+       {_drawImage.imageExtent.width, _drawImage.imageExtent.height},
+       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+       VK_IMAGE_ASPECT_DEPTH_BIT});
+
+  _renderGraph.add_pass("geometry",
+                        {{drawImage, ResourceUsage::ColorAttachment},
+                         {depthImage, ResourceUsage::DepthAttachment}},
+                        [&](VkCommandBuffer cmd) {
+                          draw_geometry(cmd,
+                                        _renderGraph.image_view(depthImage));
+                        });
+
+  if (_headless) {
+    // there is no swapchain to copy into, optionally copy the frame to the cpu
+    if (_headlessReadback) {
+      RGResource readback = _renderGraph.import_buffer(
+          "readback", get_current_frame()._readbackBuffer.buffer,
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+      _renderGraph.add_pass(
+          "readback",
+          {{drawImage, ResourceUsage::TransferSrc},
+           {readback, ResourceUsage::TransferDst}},
+          [&](VkCommandBuffer cmd) {
+            GpuPassScope gpuPass(cmd, timestamps, GpuPass::Readback);
+            vkutil::copy_image_to_buffer(
+                cmd, _drawImage.image,
+                get_current_frame()._readbackBuffer.buffer, _drawExtent);
+          });
+      _renderGraph.export_resource(readback, ResourceUsage::HostRead);
+      get_current_frame()._readbackExtent = _drawExtent;
+    } else {
+      // nothing reads the frame, but culling the whole frame would leave
+      // headless runs with nothing to measure
+      _renderGraph.export_resource(drawImage, ResourceUsage::None);
+    }
 
-  draw_background(cmd);
+    _renderGraph.execute(cmd, _transientAllocator);
 
-  vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    timestamps.end_pass(cmd, GpuPass::Frame);
+    count_frame_allocations(bufferAllocationsAtStart);
 
-  vkutil::transition_image(cmd, _depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    VK_CHECK(vkEndCommandBuffer(cmd));
 
-  draw_geometry(cmd);
+    VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+    VkSemaphoreSubmitInfo timelineInfo = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _frameTimeline,
+        frameTimelineValue);
+    VkSubmitInfo2 submit =
+        vkinit::submit_info(&cmdinfo, &timelineInfo, waitInfos);
+    submit.waitSemaphoreInfoCount = waitCount;
 
-  // transtion the draw image and the swapchain image into their correct
-  // transfer layouts
-  vkutil::transition_image(cmd, _drawImage.image,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-  vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
-                           VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+    get_current_frame()._timelineValue = frameTimelineValue;
+    _retirement.set_submitted_value(frameTimelineValue);
+
+    _frameNumber++;
+    return;
+  }
+
+  // the submit waits for the acquire at color attachment output, the first
+  // transition of the swapchain image has to wait on the same stage
+  RGResource swapchainImage = _renderGraph.import_image(
+      "swapchain image", _swapchainImages[swapchainImageIndex],
+      VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
 
   // execute a copy from the draw image into the swapchain
-  vkutil::copy_image_to_image(cmd, _drawImage.image,
+  _renderGraph.add_pass("blit",
+                        {{drawImage, ResourceUsage::TransferSrc},
+                         {swapchainImage, ResourceUsage::TransferDst}},
+                        [&](VkCommandBuffer cmd) {
+                          GpuPassScope gpuPass(cmd, timestamps, GpuPass::Blit);
+                          vkutil::copy_image_to_image(
+                              cmd, _drawImage.image,
                               _swapchainImages[swapchainImageIndex],
                               _drawExtent, _swapchainExtent);
-
-  // set swapchain image layout to Attachment Optimal so we can draw it
-  vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                        });
 
   // draw imgui into the swapchain image
-  draw_imgui(cmd, _swapchainImageViews[swapchainImageIndex]);
+  _renderGraph.add_pass(
+      "imgui", {{swapchainImage, ResourceUsage::ColorAttachment}},
+      [&](VkCommandBuffer cmd) {
+        draw_imgui(cmd, _swapchainImageViews[swapchainImageIndex]);
+      });
+
+  _renderGraph.export_resource(swapchainImage, ResourceUsage::Present);
 
-  // set swapchain image layout to Present so we can draw it
-  vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  _renderGraph.execute(cmd, _transientAllocator);
+
+  timestamps.end_pass(cmd, GpuPass::Frame);
+  count_frame_allocations(bufferAllocationsAtStart);
 
   // finalize the command buffer (we can no longer add commands, but it can now
   // be executed)
@@ -212,19 +423,26 @@ void VulkanEngine::draw() {
 
   VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
 
-  VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(
+  waitInfos[waitCount++] = vkinit::semaphore_submit_info(
       VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
       get_current_frame()._swapchainSemaphore);
-  VkSemaphoreSubmitInfo signalInfo =
+  // the binary semaphore is for present, the timeline value tells the cpu
+  // when this slot can be reused
+  VkSemaphoreSubmitInfo signalInfos[2] = {
       vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                                    get_current_frame()._renderSemaphore);
+                                    get_current_frame()._renderSemaphore),
+      vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                    _frameTimeline, frameTimelineValue)};
 
-  VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+  VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, signalInfos, waitInfos);
+  submit.signalSemaphoreInfoCount = 2;
+  submit.waitSemaphoreInfoCount = waitCount;
 
   // submit command buffer to the queue and execute it.
-  //  _renderFence will now block until the graphic commands finish execution
-  VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit,
-                          get_current_frame()._renderFence));
+  //  the frame timeline will reach frameTimelineValue once it has finished
+  VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+  get_current_frame()._timelineValue = frameTimelineValue;
+  _retirement.set_submitted_value(frameTimelineValue);
 
   // prepare present
   // this will put the image we just rendered to into the visible window.
@@ -242,15 +460,89 @@ void VulkanEngine::draw() {
 
   presentInfo.pImageIndices = &swapchainImageIndex;
 
-  VkResult presentResult = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+  VkResult presentResult;
+  {
+    PROFILE_ZONE("present");
+    presentResult = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+  }
   if (presentResult == VK_ERROR_OUT_OF_DATE_KHR) {
     resize_requested = true;
   }
 
+  auto presentTime = std::chrono::high_resolution_clock::now();
+  if (_presentStats.lastPresent.time_since_epoch().count() != 0) {
+    _presentStats.presentInterval.push(
+        std::chrono::duration<double, std::milli>(presentTime -
+                                                  _presentStats.lastPresent)
+            .count());
+  }
+  _presentStats.lastPresent = presentTime;
+
   // increase the number of frames drawn
   _frameNumber++;
-  // fmt::print("\n_frameNumber % FRAME_OVERLAP: {}",
-  //            _frameNumber % FRAME_OVERLAP);
+  // fmt::print("\n_frameNumber % _framesInFlight: {}",
+  //            _frameNumber % _framesInFlight);
+}
+
+void VulkanEngine::pace_frame() {
+  PROFILE_FUNCTION();
+  auto start = std::chrono::high_resolution_clock::now();
+
+  _frameLimiter.wait_for_frame_cap();
+
+  // with a latency target, the next frame may only start once enough of the
+  // queued frames have finished. frame k signals k + 1, so frames
+  // 0 .. _frameNumber - n - 1 are done at value _frameNumber - n, which
+  // leaves n frames running on the gpu. the slot wait in draw() already
+  // leaves at most _framesInFlight - 1
+  uint32_t budget = _frameLimiter.queued_frame_budget(
+      _gpuPassStats.rolling_mean(GpuPass::Frame), _framesInFlight);
+  if (budget + 1 < _framesInFlight && _frameNumber > (int)budget) {
+    wait_frame_timeline(static_cast<uint64_t>(_frameNumber - budget));
+  }
+
+  _presentStats.pacingWait.push(
+      std::chrono::duration<double, std::milli>(
+          std::chrono::high_resolution_clock::now() - start)
+          .count());
+}
+
+void VulkanEngine::wait_frame_timeline(uint64_t value) {
+  PROFILE_FUNCTION();
+  VkSemaphoreWaitInfo waitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &_frameTimeline;
+  waitInfo.pValues = &value;
+
+  // Timeout of 1 second
+  VK_CHECK(vkWaitSemaphores(_device, &waitInfo, 1000000000));
+}
+
+void VulkanEngine::set_frames_in_flight(uint32_t count) {
+  count = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+  if (count == _framesInFlight) {
+    return;
+  }
+
+  // frame numbers map to different slots after the switch, so every frame
+  // submitted so far has to finish and retire its resources first
+  wait_frame_timeline(static_cast<uint64_t>(_frameNumber));
+
+  _retirement.collect(static_cast<uint64_t>(_frameNumber));
+  _geometry.collect(static_cast<uint64_t>(_frameNumber));
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    _frames[i]._frameDescriptors.clear_pools(_device);
+    _frames[i]._frameDescriptorBuffer.clear();
+    read_frame_timestamps(_frames[i]);
+  }
+
+  _framesInFlight = count;
+}
+
+void VulkanEngine::set_record_threads(uint32_t count) {
+  uint32_t maxThreads = std::min(_jobs.thread_count(), MAX_RECORD_THREADS);
+  _recordThreads = std::clamp(count, 1u, maxThreads);
 }
 
 void VulkanEngine::init_mesh_pipeline() {
@@ -310,7 +602,7 @@ void VulkanEngine::init_mesh_pipeline() {
 
   // connect the image format we will draw into, from draw image
   pipelineBuilder.set_color_attachment_format(_drawImage.imageFormat);
-  pipelineBuilder.set_depth_format(_depthImage.imageFormat);
+  pipelineBuilder.set_depth_format(_depthFormat);
 
   // finally build the pipeline
   _meshPipeline = pipelineBuilder.build_pipeline(_device);
@@ -327,6 +619,7 @@ void VulkanEngine::init_mesh_pipeline() {
 
 void VulkanEngine::immediate_submit(
     std::function<void(VkCommandBuffer cmd)> &&function) {
+  PROFILE_FUNCTION();
   VK_CHECK(vkResetFences(_device, 1, &_immFence));
   VK_CHECK(vkResetCommandBuffer(_immCommandBuffer, 0));
 
@@ -351,7 +644,11 @@ void VulkanEngine::immediate_submit(
   VK_CHECK(vkWaitForFences(_device, 1, &_immFence, true, 9999999999));
 }
 
-void VulkanEngine::draw_background(VkCommandBuffer cmd) {
+void VulkanEngine::draw_background(VkCommandBuffer cmd,
+                                   GpuTimestampQueries &timestamps,
+                                   GpuStatisticsQueries &statistics) {
+  PROFILE_FUNCTION();
+  GpuPassScope gpuPass(cmd, timestamps, GpuPass::Background);
   ComputeEffect &effect = backgroundEffects[currentBackgroundEffect];
 
   // bind the background compute pipeline
@@ -366,12 +663,52 @@ void VulkanEngine::draw_background(VkCommandBuffer cmd) {
                      0, sizeof(ComputePushConstants), &effect.data);
   // execute the compute pipeline dispatch. We are using 16x16 workgroup size so
   // we need to divide by it
+  statistics.begin_pass(cmd, GpuPass::Background);
   vkCmdDispatch(cmd, static_cast<uint32_t>(std::ceil(_drawExtent.width / 16.0)),
                 static_cast<uint32_t>(std::ceil(_drawExtent.height / 16.0)), 1);
+  statistics.end_pass(cmd, GpuPass::Background);
+}
+
+void VulkanEngine::submit_async_background(uint64_t timelineValue) {
+  PROFILE_FUNCTION();
+  FrameData &frame = get_current_frame();
+  VkCommandBuffer cmd = frame._computeCommandBuffer;
+
+  // the slot's last frame has finished, and with it its compute submit
+  VK_CHECK(vkResetCommandBuffer(cmd, 0));
+  VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+  frame._computeTimestamps.begin_frame(cmd);
+
+  // the background overwrites the whole image. the draw images are shared
+  // concurrently by both queue families, so no ownership transfer is needed
+  vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_GENERAL);
+  draw_background(cmd, frame._computeTimestamps, frame._computeStatistics);
+
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  // this draw image was last rendered by the frame before the previous one,
+  // which signalled timelineValue - 2 on the frame timeline. the previous
+  // frame may still be running on the graphics queue
+  uint64_t imageReleasedValue = timelineValue > 2 ? timelineValue - 2 : 0;
+
+  VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+  VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(
+      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _frameTimeline, imageReleasedValue);
+  VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(
+      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _computeTimeline, timelineValue);
+  VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+
+  VK_CHECK(vkQueueSubmit2(_computeQueue, 1, &submit, VK_NULL_HANDLE));
 }
 
 void VulkanEngine::draw_imgui(VkCommandBuffer cmd,
                               VkImageView targetImageView) {
+  PROFILE_FUNCTION();
+  GpuPassScope gpuPass(cmd, get_current_frame()._timestamps, GpuPass::Imgui);
   VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
       targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
   VkRenderingInfo renderInfo =
@@ -384,48 +721,152 @@ void VulkanEngine::draw_imgui(VkCommandBuffer cmd,
   vkCmdEndRendering(cmd);
 }
 
-void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
-
-  // allocate a new uniform buffer for the scene data
-  AllocatedBuffer gpuSceneDataBuffer =
-      create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                    VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-  // add it to the deletion queue of this frame so it gets deleted once its been
-  // used
-  get_current_frame()._deletionQueue.push_function(
-      [=, this]() { destroy_buffer(gpuSceneDataBuffer); });
-
-  // write the buffer
-  GPUSceneData *sceneUniformData =
-      (GPUSceneData *)gpuSceneDataBuffer.allocation->GetMappedData();
-  *sceneUniformData = sceneData;
-
-  // create a descriptor set that binds that buffer and update it
-  VkDescriptorSet globalDescriptor =
-      get_current_frame()._frameDescriptors.allocate(
-          _device, _gpuSceneDataDescriptorLayout);
+void VulkanEngine::draw_geometry(VkCommandBuffer cmd, VkImageView depthView) {
+  PROFILE_FUNCTION();
+  GpuPassScope gpuPass(cmd, get_current_frame()._timestamps,
+                       GpuPass::Geometry);
+  // the scene uniforms only live for the frame, bump allocate them from
+  // the slot's linear allocator
+  LinearAllocation sceneUniforms;
+  if (_perFrameUniformBuffers) {
+    AllocatedBuffer buffer = create_buffer(
+        sizeof(GPUSceneData),
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Uniforms);
+    memcpy(buffer.info.pMappedData, &sceneData, sizeof(GPUSceneData));
+    _retirement.retire_buffer(buffer);
+    sceneUniforms = {buffer.buffer, 0, buffer.info.pMappedData};
+  } else {
+    sceneUniforms = get_current_frame()._frameAllocator.push(sceneData);
+  }
 
-  DescriptorWriter writer;
-  writer.write_buffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0,
-                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-  writer.update_set(_device, globalDescriptor);
+  // create a descriptor set that binds that buffer, or a set in the
+  // frame's descriptor buffer, and write it through the template
+  SceneDescriptorData data;
+  data.sceneData = {sceneUniforms.buffer, sceneUniforms.offset,
+                    sizeof(GPUSceneData)};
+  data.materialTable = {_materialTable.buffer(), 0, _materialTable.size()};
+
+  SceneDescriptor globalDescriptor;
+  if (_descriptorBuffers) {
+    DescriptorBufferSet set =
+        get_current_frame()._frameDescriptorBuffer.allocate(
+            _gpuSceneDataDescriptorLayout);
+    _sceneDescriptorBufferTemplate.update(_device, _descriptorBufferDevice,
+                                          set, data);
+    globalDescriptor.bufferOffset = set.offset;
+  } else {
+    globalDescriptor.set =
+        get_current_frame()
+            ._frameDescriptors.for_thread(JobSystem::thread_index())
+            .allocate(_device, _gpuSceneDataDescriptorLayout);
+    _sceneDescriptorTemplate.update(_device, globalDescriptor.set, data);
+  }
 
   // begin a render pass  connected to our draw image
   VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
       _drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
 
   VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(
-      _depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+      depthView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
   VkRenderingInfo renderInfo =
       vkinit::rendering_info(_drawExtent, &colorAttachment, &depthAttachment);
 
-  vkCmdBeginRendering(cmd, &renderInfo);
+  auto recordStart = std::chrono::high_resolution_clock::now();
+
+  std::span<const RenderObject> draws = mainDrawContext.OpaqueSurfaces;
+  uint32_t threadCount = std::clamp(
+      static_cast<uint32_t>(draws.size() / _minDrawsPerRecordThread), 1u,
+      _recordThreads);
+
+  // the statistics query has to be active around the whole rendering. while
+  // it is, secondaries can only run if they may inherit it
+  GpuStatisticsQueries &statistics = get_current_frame()._statistics;
+  bool queryStatistics = threadCount == 1 || _inheritedQueriesSupported;
+  if (queryStatistics) {
+    statistics.begin_pass(cmd, GpuPass::Geometry);
+  }
+
+  DrawCounters counters;
+  if (threadCount == 1) {
+    vkCmdBeginRendering(cmd, &renderInfo);
+    record_geometry(cmd, globalDescriptor, draws, counters);
+    vkCmdEndRendering(cmd);
+  } else {
+    FrameData &frame = get_current_frame();
+
+    // secondaries that run inside dynamic rendering have to know the
+    // attachment formats of the rendering they get executed in
+    VkCommandBufferInheritanceRenderingInfo inheritanceRendering = {};
+    inheritanceRendering.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRendering.colorAttachmentCount = 1;
+    inheritanceRendering.pColorAttachmentFormats = &_drawImage.imageFormat;
+    inheritanceRendering.depthAttachmentFormat = _depthFormat;
+    inheritanceRendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.pNext = &inheritanceRendering;
+    if (queryStatistics && statistics.pool != VK_NULL_HANDLE) {
+      inheritance.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+    }
+
+    std::array<DrawCounters, MAX_RECORD_THREADS> sliceCounters{};
+
+    // every job records a contiguous slice into the secondary of its own
+    // pool, so executing them in order keeps the single threaded draw order
+    auto recordSlice = [&](uint32_t slice) {
+      PROFILE_ZONE("record_geometry_slice");
+      size_t first = draws.size() * slice / threadCount;
+      size_t last = draws.size() * (slice + 1) / threadCount;
+
+      VkCommandBuffer secondary = frame._recordBuffers[slice];
+      VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(
+          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+          VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+      beginInfo.pInheritanceInfo = &inheritance;
+
+      VK_CHECK(vkBeginCommandBuffer(secondary, &beginInfo));
+      record_geometry(secondary, globalDescriptor,
+                      draws.subspan(first, last - first), sliceCounters[slice]);
+      VK_CHECK(vkEndCommandBuffer(secondary));
+    };
+    _jobs.parallel_for(threadCount, 1, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t slice = begin; slice < end; slice++) {
+        recordSlice(slice);
+      }
+    });
+    frame._recordBuffersUsed = threadCount;
 
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
+    renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    vkCmdBeginRendering(cmd, &renderInfo);
+    vkCmdExecuteCommands(cmd, threadCount, frame._recordBuffers);
+    vkCmdEndRendering(cmd);
 
-  // set dynamic viewport and scissor
+    for (uint32_t slice = 0; slice < threadCount; slice++) {
+      counters.add(sliceCounters[slice]);
+    }
+  }
+
+  if (queryStatistics) {
+    statistics.end_pass(cmd, GpuPass::Geometry);
+  }
+  _frameStats.cpu = counters;
+
+  _lastGeometryRecordMs =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::high_resolution_clock::now() - recordStart)
+          .count();
+}
+
+void VulkanEngine::record_geometry(VkCommandBuffer cmd,
+                                   const SceneDescriptor &globalDescriptor,
+                                   std::span<const RenderObject> draws,
+                                   DrawCounters &counters) {
+  // dynamic state is not inherited by secondaries, so every range sets it
   VkViewport viewport = {};
   viewport.x = 0;
   viewport.y = 0;
@@ -444,43 +885,70 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
 
   vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-  // bind a texture
-  VkDescriptorSet imageSet = get_current_frame()._frameDescriptors.allocate(
-      _device, _singleImageDescriptorLayout);
-  {
-    DescriptorWriter writer;
-    writer.write_image(0, _errorCheckerboardImage.imageView,
-                       _defaultSamplerNearest,
-                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-
-    writer.update_set(_device, imageSet);
+  // the mesh pipelines share their layout, so the scene set and the
+  // bindless heap stay bound for the whole command buffer
+  if (_descriptorBuffers) {
+    VkDescriptorBufferBindingInfoEXT buffers[] = {
+        get_current_frame()._frameDescriptorBuffer.binding_info(),
+        _bindless.descriptor_buffer().binding_info()};
+    _descriptorBufferDevice.cmdBindBuffers(cmd, 2, buffers);
+
+    uint32_t bufferIndices[] = {0, 1};
+    VkDeviceSize offsets[] = {globalDescriptor.bufferOffset,
+                              _bindless.buffer_offset()};
+    _descriptorBufferDevice.cmdSetOffsets(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        metalRoughMaterial.opaquePipeline.layout, 0, 2, bufferIndices,
+        offsets);
+  } else {
+    VkDescriptorSet sets[] = {globalDescriptor.set, _bindless.set()};
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            metalRoughMaterial.opaquePipeline.layout, 0, 2,
+                            sets, 0, nullptr);
   }
+  counters.descriptorSetBinds += 2;
 
-  for (const RenderObject &draw : mainDrawContext.OpaqueSurfaces) {
+  uint64_t uploadedValue = _uploads.acquired_value();
+  uint32_t boundGeometryBlock = UINT32_MAX;
+  MaterialPipeline *boundPipeline = nullptr;
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      draw.material->pipeline->pipeline);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            draw.material->pipeline->layout, 0, 1,
-                            &globalDescriptor, 0, nullptr);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            draw.material->pipeline->layout, 1, 1,
-                            &draw.material->materialSet, 0, nullptr);
+  for (const RenderObject &draw : draws) {
+    // meshes still uploading pop in once a frame has acquired them
+    if (draw.upload.value > uploadedValue) {
+      continue;
+    }
 
-    vkCmdBindIndexBuffer(cmd, draw.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    const MaterialInstance &material = _materials.get(draw.material);
+
+    if (material.pipeline != boundPipeline) {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        material.pipeline->pipeline);
+      boundPipeline = material.pipeline;
+      counters.pipelineBinds++;
+    }
+
+    // meshes in the same pool block share the index buffer
+    if (draw.geometryBlock != boundGeometryBlock) {
+      vkCmdBindIndexBuffer(cmd, _geometry.index_buffer(draw.geometryBlock), 0,
+                           VK_INDEX_TYPE_UINT32);
+      boundGeometryBlock = draw.geometryBlock;
+      counters.indexBufferBinds++;
+    }
 
     GPUDrawPushConstants pushConstants;
-    pushConstants.vertexBuffer = draw.vertexBufferAddress;
+    pushConstants.vertexBuffer = _geometry.vertex_address(draw.geometryBlock);
     pushConstants.worldMatrix = draw.transform;
-    vkCmdPushConstants(cmd, draw.material->pipeline->layout,
+    pushConstants.materialIndex = material.materialIndex;
+    vkCmdPushConstants(cmd, material.pipeline->layout,
                        VK_SHADER_STAGE_VERTEX_BIT, 0,
                        sizeof(GPUDrawPushConstants), &pushConstants);
+    counters.pushConstantUpdates++;
 
-    vkCmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, 0, 0);
+    vkCmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex,
+                     draw.vertexOffset, 0);
+    counters.draws++;
+    counters.triangles += draw.indexCount / 3;
   }
-
-  vkCmdEndRendering(cmd);
 }
 
 void VulkanEngine::run() {
@@ -489,6 +957,11 @@ void VulkanEngine::run() {
 
   // main loop
   while (!bQuit) {
+    PROFILE_ZONE("frame");
+
+    // pace before polling input, so the frame starts with the newest events
+    pace_frame();
+
     // Handle events on queue
     while (SDL_PollEvent(&e) != 0) {
       // close the window when user alt-f4s or clicks the X button
@@ -528,7 +1001,24 @@ void VulkanEngine::run() {
 
     if (ImGui::Begin("background")) {
 
-      ImGui::SliderFloat("Render Scale", &renderScale, 0.3f, 1.f);
+      ImGui::SliderFloat("Render Scale", &renderScale, 0.3f, 2.f);
+
+      int framesInFlight = static_cast<int>(_framesInFlight);
+      if (ImGui::SliderInt("Frames In Flight", &framesInFlight, 1,
+                           MAX_FRAMES_IN_FLIGHT)) {
+        set_frames_in_flight(static_cast<uint32_t>(framesInFlight));
+      }
+
+      int recordThreads = static_cast<int>(_recordThreads);
+      int maxRecordThreads =
+          static_cast<int>(std::min(_jobs.thread_count(), MAX_RECORD_THREADS));
+      if (ImGui::SliderInt("Record Threads", &recordThreads, 1,
+                           maxRecordThreads)) {
+        set_record_threads(static_cast<uint32_t>(recordThreads));
+      }
+      ImGui::Text("draws %zu, recorded in %.3f ms",
+                  mainDrawContext.OpaqueSurfaces.size(),
+                  _lastGeometryRecordMs);
 
       ComputeEffect &selected = backgroundEffects[currentBackgroundEffect];
 
@@ -544,17 +1034,646 @@ void VulkanEngine::run() {
     }
     ImGui::End();
 
+    if (ImGui::Begin("presentation")) {
+      int policy = static_cast<int>(_presentPolicy);
+      if (ImGui::Combo("Present Mode", &policy,
+                       "fifo\0mailbox\0immediate\0fifo_relaxed\0")) {
+        _presentPolicy = static_cast<PresentPolicy>(policy);
+        // the swapchain gets rebuilt with the new mode next frame
+        resize_requested = true;
+      }
+      ImGui::Text("active mode: %s", string_VkPresentModeKHR(_presentMode));
+
+      ImGui::SliderFloat("FPS Cap", &_frameLimiter.targetFps, 0.f, 240.f);
+      ImGui::SliderFloat("Latency Target (ms)",
+                         &_frameLimiter.targetLatencyMs, 0.f, 100.f);
+
+      auto showTiming = [](const char *label, const RollingSamples &samples) {
+        SampleSummary summary = samples.summary();
+        ImGui::Text("%-16s mean %6.2f  p99 %6.2f ms", label, summary.mean,
+                    summary.p99);
+      };
+      showTiming("acquire wait", _presentStats.acquireWait);
+      showTiming("frame wait", _presentStats.frameWait);
+      showTiming("pacing wait", _presentStats.pacingWait);
+      showTiming("present interval", _presentStats.presentInterval);
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("gpu passes")) {
+      for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        SampleSummary summary = _gpuPassStats.rolling[pass].summary();
+        if (summary.count == 0) {
+          continue;
+        }
+        ImGui::Text("%-12s mean %6.3f  p95 %6.3f  p99 %6.3f ms",
+                    gpu_pass_name(static_cast<GpuPass>(pass)), summary.mean,
+                    summary.p95, summary.p99);
+      }
+      if (ImGui::Button("Dump CSV")) {
+        _gpuPassStats.write_csv("gpu_passes.csv");
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("frame stats")) {
+      const DrawCounters &cpu = _frameStats.cpu;
+      ImGui::Text("draws %u  triangles %llu", cpu.draws,
+                  (unsigned long long)cpu.triangles);
+      ImGui::Text("pipeline binds %u  descriptor binds %u  push constants %u",
+                  cpu.pipelineBinds, cpu.descriptorSetBinds,
+                  cpu.pushConstantUpdates);
+      GeometryPool::Stats geometry = _geometry.stats();
+      ImGui::Text("index buffer binds %u  geometry %u meshes in %u blocks, "
+                  "%.1f / %.1f MiB",
+                  cpu.indexBufferBinds, geometry.ranges, geometry.blocks,
+                  geometry.usedBytes / (1024.0 * 1024.0),
+                  geometry.capacityBytes / (1024.0 * 1024.0));
+      ImGui::Text("geometry blocks created %llu  released %llu",
+                  (unsigned long long)geometry.blocksCreated,
+                  (unsigned long long)geometry.blocksReleased);
+
+      if (_pipelineStatisticsSupported) {
+        const PipelineStatistics &gpu = _frameStats.gpu;
+        ImGui::Text("input primitives %llu",
+                    (unsigned long long)gpu.inputPrimitives);
+        ImGui::Text("vertex invocations %llu",
+                    (unsigned long long)gpu.vertexInvocations);
+        ImGui::Text("clipping in %llu  out %llu",
+                    (unsigned long long)gpu.clippingInvocations,
+                    (unsigned long long)gpu.clippingPrimitives);
+        ImGui::Text("fragment invocations %llu",
+                    (unsigned long long)gpu.fragmentInvocations);
+        ImGui::Text("compute invocations %llu",
+                    (unsigned long long)gpu.computeInvocations);
+      } else {
+        ImGui::Text("pipeline statistics not supported");
+      }
+
+      const UploadQueue::Stats &uploads = _uploads.stats();
+      ImGui::Text("uploads %llu in %llu submits  ring flushes %llu",
+                  (unsigned long long)uploads.uploads,
+                  (unsigned long long)uploads.batches,
+                  (unsigned long long)uploads.ringFlushes);
+      ImGui::Text("retired resources pending %zu  destroyed %llu",
+                  _retirement.pending(),
+                  (unsigned long long)_retirement.destroyed());
+      ImGui::Text("linear allocations %u  %llu bytes  vma buffers %u",
+                  _frameStats.linearAllocations,
+                  (unsigned long long)_frameStats.linearBytes,
+                  _frameStats.bufferAllocations);
+
+      const RenderGraph::Stats &graph = _renderGraph.stats();
+      ImGui::Text("graph passes %u  culled %u", graph.passes,
+                  graph.culledPasses);
+      ImGui::Text("barrier batches %u  image %u  buffer %u",
+                  graph.barrierBatches, graph.imageBarriers,
+                  graph.bufferBarriers);
+
+      const TransientAllocator::Stats &transient = _transientAllocator.stats();
+      ImGui::Text("transient %u resources  %u blocks  %.2f MiB",
+                  transient.resources, transient.blocks,
+                  transient.allocatedBytes / (1024.0 * 1024.0));
+      ImGui::Text("aliasing saved %.2f MiB",
+                  transient.saved_bytes() / (1024.0 * 1024.0));
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("memory")) {
+      ImGui::Text("budgets from %s", _memoryTelemetry.budget_extension()
+                                         ? "VK_EXT_memory_budget"
+                                         : "vma estimates");
+      for (const HeapBudget &heap : _memoryTelemetry.heaps()) {
+        ImGui::Text("heap %u%s  %.1f / %.1f MiB, vma %.1f MiB", heap.heap,
+                    heap.deviceLocal ? " (device local)" : "",
+                    heap.usage / (1024.0 * 1024.0),
+                    heap.budget / (1024.0 * 1024.0),
+                    heap.blockBytes / (1024.0 * 1024.0));
+      }
+      for (size_t i = 0; i < MemoryCategoryCount; i++) {
+        MemoryCategory category = static_cast<MemoryCategory>(i);
+        ImGui::Text("%s  %.2f MiB", memory_category_name(category),
+                    _memoryTelemetry.bytes(category) / (1024.0 * 1024.0));
+      }
+      if (ImGui::Button("Export VMA JSON")) {
+        _memoryTelemetry.write_json("vma_stats.json");
+      }
+
+      const Defragmenter::Stats &defrag = _defragmenter.stats();
+      ImGui::Text("defragmentation %s, %llu passes",
+                  _defragmenter.running() ? "running" : "idle",
+                  (unsigned long long)defrag.passes);
+      ImGui::Text("moved %.2f MiB, freed %.2f MiB in %llu blocks",
+                  defrag.bytesMoved / (1024.0 * 1024.0),
+                  defrag.bytesFreed / (1024.0 * 1024.0),
+                  (unsigned long long)defrag.blocksFreed);
+      BindlessHeap::Stats bindless = _bindless.stats();
+      ImGui::Text("bindless heap %u / %u images, %u / %u samplers",
+                  bindless.images, bindless.imageCapacity, bindless.samplers,
+                  bindless.samplerCapacity);
+      if (bindless.imageFallbacks > 0 || bindless.samplerFallbacks > 0) {
+        ImGui::Text("bindless heap full: %llu images, %llu samplers on the "
+                    "fallback slot",
+                    (unsigned long long)bindless.imageFallbacks,
+                    (unsigned long long)bindless.samplerFallbacks);
+      }
+      MaterialTable::Stats materials = _materialTable.stats();
+      ImGui::Text("material table %u / %u records, %llu bytes copied",
+                  materials.records, materials.capacity,
+                  (unsigned long long)materials.bytesCopied);
+      DescriptorAllocatorGrowable::Stats descriptors =
+          frame_descriptor_stats();
+      ImGui::Text("frame descriptors %u pools, %u / %u sets, %u / %u "
+                  "descriptors",
+                  descriptors.pools, descriptors.sets,
+                  descriptors.reservedSets, descriptors.descriptors,
+                  descriptors.reservedDescriptors);
+      ImGui::Text("%llu fall-throughs (%llu fragmented), %llu retunes",
+                  (unsigned long long)descriptors.fallthroughs,
+                  (unsigned long long)descriptors.fragmentedFailures,
+                  (unsigned long long)descriptors.retunes);
+      if (ImGui::Button("Defragment")) {
+        _defragmenter.start();
+      }
+    }
+    ImGui::End();
+
+#ifdef ENGINE_PROFILING
+    if (ImGui::Begin("profiler")) {
+      if (ImGui::Button("Export Chrome Trace")) {
+        profiler::write_chrome_trace("trace.json");
+      }
+    }
+    ImGui::End();
+#endif
+
     ImGui::Render();
 
     draw();
   }
 }
+
+void VulkanEngine::count_frame_allocations(uint64_t bufferAllocationsAtStart) {
+  const LinearAllocator &frameAllocator = get_current_frame()._frameAllocator;
+  _frameStats.linearAllocations = frameAllocator.allocations();
+  _frameStats.linearBytes = frameAllocator.used_bytes();
+  _frameStats.bufferAllocations =
+      static_cast<uint32_t>(_bufferAllocations - bufferAllocationsAtStart);
+}
+
+void VulkanEngine::read_frame_timestamps(FrameData &frame) {
+  _gpuPassStats.read_frame(_device, frame._timestamps, _timestampPeriod);
+  frame._statistics.read(_device, _frameStats.gpu);
+  if (_asyncCompute) {
+    _gpuPassStats.read_frame(_device, frame._computeTimestamps,
+                             _timestampPeriod);
+  }
+}
+
+void VulkanEngine::run_benchmark(uint32_t frameCount) {
+  std::vector<double> frameTimes;
+  std::vector<double> cpuTimes;
+  std::vector<double> recordTimes;
+  frameTimes.reserve(frameCount);
+  cpuTimes.reserve(frameCount);
+  recordTimes.reserve(frameCount);
+
+  _gpuPassStats.start_recording();
+  uint64_t bufferAllocationsAtStart = _bufferAllocations;
+
+  for (uint32_t i = 0; i < frameCount; i++) {
+    if (!_headless) {
+      // keep the window responsive, but ignore input
+      SDL_Event e;
+      while (SDL_PollEvent(&e) != 0) {
+        ImGui_ImplSDL2_ProcessEvent(&e);
+      }
+
+      if (resize_requested) {
+        resize_swapchain();
+      }
+
+      // draw_imgui expects draw data for the frame, submit an empty one
+      ImGui_ImplVulkan_NewFrame();
+      ImGui_ImplSDL2_NewFrame();
+      ImGui::NewFrame();
+      ImGui::Render();
+    }
+
+    pace_frame();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    draw();
+
+    double frameMs = std::chrono::duration<double, std::milli>(
+                         std::chrono::high_resolution_clock::now() - start)
+                         .count();
+    frameTimes.push_back(frameMs);
+    // cpu time is everything draw() did besides waiting on the gpu
+    cpuTimes.push_back(frameMs - _lastFrameWaitMs);
+    recordTimes.push_back(_lastGeometryRecordMs);
+  }
+
+  // collect the timestamps of the frames that were still in flight
+  vkDeviceWaitIdle(_device);
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    read_frame_timestamps(_frames[i]);
+  }
+  _gpuPassStats.recording = false;
+
+  fmt::println("benchmark: {} frames, {} in flight, {} record threads, {}x{} "
+               "draw extent{}",
+               frameCount, _framesInFlight, _recordThreads, _drawExtent.width,
+               _drawExtent.height, _headless ? ", headless" : "");
+  print_sample_summary("frame ms", summarize_samples(frameTimes));
+  print_sample_summary("cpu ms", summarize_samples(cpuTimes));
+  print_sample_summary("record ms", summarize_samples(recordTimes));
+  for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++) {
+    if (_gpuPassStats.recorded[pass].empty()) {
+      continue;
+    }
+    print_sample_summary(
+        fmt::format("gpu {}", gpu_pass_name(static_cast<GpuPass>(pass))),
+        summarize_samples(_gpuPassStats.recorded[pass]));
+  }
+
+  fmt::println("{:.2f} vma buffer allocations per frame, last frame {} "
+               "linear allocations of {} bytes{}",
+               double(_bufferAllocations - bufferAllocationsAtStart) /
+                   frameCount,
+               _frameStats.linearAllocations, _frameStats.linearBytes,
+               _perFrameUniformBuffers ? ", per frame uniform buffers" : "");
+
+  print_memory_telemetry();
+
+  const DrawCounters &cpu = _frameStats.cpu;
+  fmt::println("last frame: {} draws, {} triangles, {} pipeline binds, {} "
+               "descriptor binds, {} push constants, {} index buffer binds",
+               cpu.draws, cpu.triangles, cpu.pipelineBinds,
+               cpu.descriptorSetBinds, cpu.pushConstantUpdates,
+               cpu.indexBufferBinds);
+  if (_pipelineStatisticsSupported) {
+    const PipelineStatistics &gpu = _frameStats.gpu;
+    fmt::println("last frame: {} vertex, {} fragment, {} compute invocations, "
+                 "{} of {} primitives past clipping",
+                 gpu.vertexInvocations, gpu.fragmentInvocations,
+                 gpu.computeInvocations, gpu.clippingPrimitives,
+                 gpu.clippingInvocations);
+  }
+}
+
+void VulkanEngine::print_memory_telemetry() {
+  _memoryTelemetry.update(static_cast<uint32_t>(_frameNumber));
+  for (const HeapBudget &heap : _memoryTelemetry.heaps()) {
+    fmt::println("heap {}{}: {:.1f} of {:.1f} MiB budget, {:.1f} MiB in vma "
+                 "blocks",
+                 heap.heap, heap.deviceLocal ? " (device local)" : "",
+                 heap.usage / (1024.0 * 1024.0),
+                 heap.budget / (1024.0 * 1024.0),
+                 heap.blockBytes / (1024.0 * 1024.0));
+  }
+  for (size_t i = 0; i < MemoryCategoryCount; i++) {
+    MemoryCategory category = static_cast<MemoryCategory>(i);
+    fmt::println("{}: {:.2f} MiB", memory_category_name(category),
+                 _memoryTelemetry.bytes(category) / (1024.0 * 1024.0));
+  }
+
+  const Defragmenter::Stats &defrag = _defragmenter.stats();
+  fmt::println("defragmentation: {} runs, {} allocations moved, {:.2f} MiB "
+               "freed",
+               defrag.defragmentations, defrag.allocationsMoved,
+               defrag.bytesFreed / (1024.0 * 1024.0));
+
+  const TransientAllocator::Stats &transient = _transientAllocator.stats();
+  fmt::println("transient memory: {} resources in {} blocks, {:.2f} MiB, "
+               "aliasing saved {:.2f} MiB",
+               transient.resources, transient.blocks,
+               transient.allocatedBytes / (1024.0 * 1024.0),
+               transient.saved_bytes() / (1024.0 * 1024.0));
+
+  DescriptorAllocatorGrowable::Stats descriptors = frame_descriptor_stats();
+  float used = descriptors.reservedDescriptors > 0
+                   ? float(descriptors.descriptors) /
+                         descriptors.reservedDescriptors
+                   : 0.f;
+  fmt::println("frame descriptors: {} pools, {:.0f}% of {} descriptors "
+               "used, {} fall-throughs ({} fragmented), {} retunes",
+               descriptors.pools, used * 100.f,
+               descriptors.reservedDescriptors, descriptors.fallthroughs,
+               descriptors.fragmentedFailures, descriptors.retunes);
+}
+
+DescriptorAllocatorGrowable::Stats VulkanEngine::frame_descriptor_stats() {
+  DescriptorAllocatorGrowable::Stats total;
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    total.add(_frames[i]._frameDescriptors.stats());
+  }
+  return total;
+}
+
+void VulkanEngine::check_fragmentation() {
+  if (_defragmenter.running() || _frameNumber % _defragCheckInterval != 0) {
+    return;
+  }
+
+  for (const HeapBudget &heap : _memoryTelemetry.heaps()) {
+    VkDeviceSize unused = heap.blockBytes - heap.allocationBytes;
+    if (heap.deviceLocal &&
+        unused > VkDeviceSize(_defragUnusedRatio * heap.blockBytes)) {
+      _defragmenter.start();
+      return;
+    }
+  }
+}
+
+VmaDefragmentationMoveOperation
+VulkanEngine::move_allocation(const VmaDefragmentationMove &move,
+                              VkCommandBuffer cmd) {
+  uint32_t id;
+  switch (get_defrag_owner(_allocator, move.srcAllocation, id)) {
+  case DefragOwner::PooledImage:
+    return move_image(ImageHandle{id}, move.dstTmpAllocation, cmd);
+  default:
+    return VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+  }
+}
+
+VmaDefragmentationMoveOperation
+VulkanEngine::move_image(ImageHandle handle, VmaAllocation destination,
+                         VkCommandBuffer cmd) {
+  // retired images keep their allocation until the frames are done
+  if (!_images.valid(handle)) {
+    return VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+  }
+
+  // only uploaded images are moved, those are known to be acquired and in
+  // SHADER_READ_ONLY_OPTIMAL
+  AllocatedImage &image = _images.get(handle);
+  VkImageUsageFlags transfer =
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  if (image.upload.value == 0 || !_uploads.is_ready(image.upload) ||
+      (image.imageUsage & transfer) != transfer) {
+    return VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+  }
+
+  VkImageCreateInfo imageInfo = vkinit::image_create_info(
+      image.imageFormat, image.imageUsage, image.imageExtent);
+  imageInfo.mipLevels = image.mipLevels;
+  VkImage newImage;
+  VK_CHECK(vkCreateImage(_device, &imageInfo, nullptr, &newImage));
+  VK_CHECK(vmaBindImageMemory(_allocator, destination, newImage));
+
+  VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(
+      image.imageFormat, newImage, VK_IMAGE_ASPECT_COLOR_BIT);
+  viewInfo.subresourceRange.levelCount = image.mipLevels;
+  VkImageView newView;
+  VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &newView));
+
+  vkutil::transition_image(cmd, image.image,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  vkutil::transition_image(cmd, newImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  std::vector<VkImageCopy> regions(image.mipLevels);
+  for (uint32_t mip = 0; mip < image.mipLevels; mip++) {
+    VkImageCopy &region = regions[mip];
+    region = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+    region.dstSubresource = region.srcSubresource;
+    region.extent = {std::max(image.imageExtent.width >> mip, 1u),
+                     std::max(image.imageExtent.height >> mip, 1u),
+                     std::max(image.imageExtent.depth >> mip, 1u)};
+  }
+  vkCmdCopyImage(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 static_cast<uint32_t>(regions.size()), regions.data());
+
+  vkutil::transition_image(cmd, newImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  _defragmenter.retire_image(image.image, image.imageView);
+  _retirement.retrack(resource_handle(image.image), resource_handle(newImage));
+  image.image = newImage;
+  image.imageView = newView;
+
+  // frames in flight may still sample the old slot
+  _bindless.retire_image(image.bindlessIndex, _retirement.submitted_value());
+  image.bindlessIndex = _bindless.add_image(newView);
+  metalRoughMaterial.update_image(this, handle);
+  return VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+}
+
+void VulkanEngine::run_recording_benchmark(uint32_t frameCount) {
+  uint32_t maxThreads = std::min(_jobs.thread_count(), MAX_RECORD_THREADS);
+  uint32_t previousThreads = _recordThreads;
+
+  // powers of two, then the full pool if that isn't one
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t count = 1; count < maxThreads; count *= 2) {
+    threadCounts.push_back(count);
+  }
+  threadCounts.push_back(maxThreads);
+
+  for (uint32_t count : threadCounts) {
+    set_record_threads(count);
+    run_benchmark(frameCount);
+    fmt::println("{} draws per frame", mainDrawContext.OpaqueSurfaces.size());
+  }
+
+  set_record_threads(previousThreads);
+}
+
+void VulkanEngine::run_descriptor_benchmark(uint32_t frameCount,
+                                            uint32_t setsPerFrame) {
+  // a uniform buffer and a texture per set, what a per draw material set
+  // used to hold. nothing is submitted, only the cpu side is timed
+  AllocatedBuffer uniforms =
+      create_buffer(sizeof(GPUSceneData),
+                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                    VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Uniforms);
+  VkImageView view = _images.get(_errorCheckerboardImage).imageView;
+
+  auto write_set = [&](DescriptorWriter &writer) {
+    writer.clear();
+    writer.write_buffer(0, uniforms.buffer, sizeof(GPUSceneData), 0,
+                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    writer.write_image(1, view, _defaultSamplerNearest,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+  };
+
+  DescriptorLayoutBuilder builder;
+  builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+  builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+  fmt::println("descriptor benchmark: {} frames, {} sets per frame",
+               frameCount, setsPerFrame);
+
+  // pools, reset once per frame like the frame descriptors
+  {
+    VkDescriptorSetLayout layout = builder.build(
+        _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}};
+    DescriptorAllocatorGrowable allocator;
+    allocator.init(_device, setsPerFrame, sizes);
+
+    DescriptorWriter writer;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frameCount);
+    for (uint32_t i = 0; i < frameCount; i++) {
+      auto start = std::chrono::high_resolution_clock::now();
+      allocator.clear_pools(_device);
+      for (uint32_t s = 0; s < setsPerFrame; s++) {
+        VkDescriptorSet set = allocator.allocate(_device, layout);
+        write_set(writer);
+        writer.update_set(_device, set);
+      }
+      frameTimes.push_back(
+          std::chrono::duration<double, std::milli>(
+              std::chrono::high_resolution_clock::now() - start)
+              .count());
+    }
+    print_sample_summary("pools ms", summarize_samples(frameTimes));
+
+    // the same sets written through an update template
+    struct SetData {
+      VkDescriptorBufferInfo uniforms;
+      VkDescriptorImageInfo image;
+    };
+    SetData data;
+    data.uniforms = {uniforms.buffer, 0, sizeof(GPUSceneData)};
+    data.image = {_defaultSamplerNearest, view,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    DescriptorUpdateTemplate updateTemplate =
+        builder.build_template(_device, layout);
+
+    frameTimes.clear();
+    for (uint32_t i = 0; i < frameCount; i++) {
+      auto start = std::chrono::high_resolution_clock::now();
+      allocator.clear_pools(_device);
+      for (uint32_t s = 0; s < setsPerFrame; s++) {
+        VkDescriptorSet set = allocator.allocate(_device, layout);
+        updateTemplate.update(_device, set, data);
+      }
+      frameTimes.push_back(
+          std::chrono::duration<double, std::milli>(
+              std::chrono::high_resolution_clock::now() - start)
+              .count());
+    }
+    print_sample_summary("pools, update template ms",
+                         summarize_samples(frameTimes));
+
+    updateTemplate.destroy(_device);
+    allocator.destroy_pools(_device);
+    unregister_descriptor_layout(layout);
+    vkDestroyDescriptorSetLayout(_device, layout, nullptr);
+  }
+
+  if (!_descriptorBuffers) {
+    fmt::println("descriptor buffers: not available on this device");
+    destroy_buffer(uniforms);
+    return;
+  }
+
+  // descriptor buffers, bump allocated and written in place
+  {
+    VkDescriptorSetLayout layout = builder.build(
+        _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr, VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+    VkDeviceSize setSize;
+    _descriptorBufferDevice.getLayoutSize(_device, layout, &setSize);
+    VkDeviceSize alignment =
+        _descriptorBufferDevice.properties.descriptorBufferOffsetAlignment;
+    setSize = (setSize + alignment - 1) & ~(alignment - 1);
+
+    // combined image samplers need the sampler usage as well
+    DescriptorBufferAllocator allocator;
+    allocator.init(_device, _allocator, &_descriptorBufferDevice,
+                   setSize * setsPerFrame,
+                   VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                       VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    DescriptorWriter writer;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frameCount);
+    for (uint32_t i = 0; i < frameCount; i++) {
+      auto start = std::chrono::high_resolution_clock::now();
+      allocator.clear();
+      for (uint32_t s = 0; s < setsPerFrame; s++) {
+        DescriptorBufferSet set = allocator.allocate(layout);
+        write_set(writer);
+        writer.update_buffer(_device, _descriptorBufferDevice, set);
+      }
+      frameTimes.push_back(
+          std::chrono::duration<double, std::milli>(
+              std::chrono::high_resolution_clock::now() - start)
+              .count());
+    }
+    print_sample_summary("descriptor buffers ms",
+                         summarize_samples(frameTimes));
+    fmt::println("descriptor buffers: {} bytes per set", setSize);
+
+    allocator.destroy(_allocator);
+    unregister_descriptor_layout(layout);
+    vkDestroyDescriptorSetLayout(_device, layout, nullptr);
+  }
+
+  destroy_buffer(uniforms);
+}
+
+bool VulkanEngine::write_readback_ppm(const char *path) {
+  if (!_headless || !_headlessReadback || _frameNumber == 0) {
+    return false;
+  }
+
+  // make sure the last frame has landed in its readback buffer
+  vkDeviceWaitIdle(_device);
+
+  FrameData &frame = _frames[(_frameNumber - 1) % _framesInFlight];
+  VkExtent2D extent = frame._readbackExtent;
+
+  vmaInvalidateAllocation(_allocator, frame._readbackBuffer.allocation, 0,
+                          VK_WHOLE_SIZE);
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+  // the draw image is RGBA16F, one uint64 per pixel. values are written as
+  // they are, without tonemapping
+  const uint64_t *pixels =
+      (const uint64_t *)frame._readbackBuffer.info.pMappedData;
+  std::vector<uint8_t> row(extent.width * 3);
+  for (uint32_t y = 0; y < extent.height; y++) {
+    for (uint32_t x = 0; x < extent.width; x++) {
+      glm::vec4 color = glm::unpackHalf4x16(pixels[y * extent.width + x]);
+      for (int c = 0; c < 3; c++) {
+        row[x * 3 + c] = static_cast<uint8_t>(
+            std::clamp(color[c], 0.f, 1.f) * 255.f + 0.5f);
+      }
+    }
+    file.write((const char *)row.data(), row.size());
+  }
+
+  return true;
+}
 AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format,
                                           VkImageUsageFlags usage,
-                                          bool mipmapped) {
+                                          bool mipmapped,
+                                          MemoryCategory category) {
   AllocatedImage newImage;
   newImage.imageFormat = format;
   newImage.imageExtent = size;
+  newImage.imageUsage = usage;
 
   VkImageCreateInfo img_info = vkinit::image_create_info(format, usage, size);
   if (mipmapped) {
@@ -562,6 +1681,7 @@ AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format,
                              std::log2(std::max(size.width, size.height)))) +
                          1;
   }
+  newImage.mipLevels = img_info.mipLevels;
 
   // always allocate images on dedicated GPU memory
   VmaAllocationCreateInfo allocinfo = {};
@@ -570,8 +1690,11 @@ AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format,
       VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
   // allocate and create the image
+  VmaAllocationInfo allocationInfo;
   VK_CHECK(vmaCreateImage(_allocator, &img_info, &allocinfo, &newImage.image,
-                          &newImage.allocation, nullptr));
+                          &newImage.allocation, &allocationInfo));
+  _retirement.track(ResourceType::Image, resource_handle(newImage.image),
+                    allocationInfo.size, category);
 
   // if the format is a depth format, we will need to have it use the correct
   // aspect flag
@@ -596,47 +1719,88 @@ AllocatedImage VulkanEngine::create_image(void *data, VkExtent3D size,
                                           VkImageUsageFlags usage,
                                           bool mipmapped) {
   size_t data_size = size.depth * size.width * size.height * 4;
-  AllocatedBuffer uploadbuffer = create_buffer(
-      data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+  StagingAllocation staging = _uploads.stage(data_size);
 
-  memcpy(uploadbuffer.info.pMappedData, data, data_size);
+  memcpy(staging.data, data, data_size);
 
   AllocatedImage new_image = create_image(
       size, format,
       usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
       mipmapped);
 
-  immediate_submit([&](VkCommandBuffer cmd) {
-    vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED,
-                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    VkBufferImageCopy copyRegion = {};
-    copyRegion.bufferOffset = 0;
-    copyRegion.bufferRowLength = 0;
-    copyRegion.bufferImageHeight = 0;
-
-    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-    copyRegion.imageExtent = size;
-
-    // copy the buffer into the image
-    vkCmdCopyBufferToImage(cmd, uploadbuffer.buffer, new_image.image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                           &copyRegion);
-
-    vkutil::transition_image(cmd, new_image.image,
-                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-  });
-
-  destroy_buffer(uploadbuffer);
+  // the release transitions it to shader read only for the fragment shader
+  UploadImageRelease release = {
+      new_image.image, VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+
+  new_image.upload = _uploads.record(
+      [&](VkCommandBuffer cmd) {
+        vkutil::transition_image(cmd, new_image.image,
+                                 VK_IMAGE_LAYOUT_UNDEFINED,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = staging.offset;
+        copyRegion.bufferRowLength = 0;
+        copyRegion.bufferImageHeight = 0;
+
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = 0;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = size;
+
+        // copy the buffer into the image
+        vkCmdCopyBufferToImage(cmd, staging.buffer, new_image.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                               &copyRegion);
+      },
+      {}, std::span(&release, 1));
 
   return new_image;
 }
 
+ImageHandle VulkanEngine::add_image(const AllocatedImage &image) {
+  AllocatedImage pooled = image;
+  pooled.bindlessIndex = _bindless.add_image(image.imageView);
+  ImageHandle handle = _images.add(pooled);
+  set_defrag_owner(_allocator, image.allocation, DefragOwner::PooledImage,
+                   handle.value);
+  return handle;
+}
+
+void VulkanEngine::destroy_buffer(BufferHandle buffer) {
+  destroy_buffer(_buffers.remove(buffer));
+}
+
+void VulkanEngine::destroy_image(ImageHandle image) {
+  AllocatedImage pooled = _images.remove(image);
+  _bindless.free_image(pooled.bindlessIndex);
+  destroy_image(pooled);
+}
+
+void VulkanEngine::retire_image(ImageHandle image) {
+  AllocatedImage pooled = _images.remove(image);
+  _bindless.retire_image(pooled.bindlessIndex, _retirement.submitted_value());
+  _retirement.retire_image(pooled);
+}
+
+void VulkanEngine::destroy_pooled_resources() {
+  _images.for_each([this](ImageHandle, const AllocatedImage &image) {
+    destroy_image(image);
+  });
+  _buffers.for_each([this](BufferHandle, const AllocatedBuffer &buffer) {
+    destroy_buffer(buffer);
+  });
+  _images = {};
+  _buffers = {};
+  _materials = {};
+}
+
 void VulkanEngine::destroy_image(const AllocatedImage &img) {
+  _retirement.untrack(resource_handle(img.image));
   vkDestroyImageView(_device, img.imageView, nullptr);
   vmaDestroyImage(_allocator, img.image, img.allocation);
 }
@@ -649,6 +1813,7 @@ void VulkanEngine::init_vulkan() {
                       .request_validation_layers(bUseValidationLayers)
                       .use_default_debug_messenger()
                       .require_api_version(1, 3, 0)
+                      .set_headless(_headless)
                       .build();
 
   vkb::Instance vkb_inst = inst_ret.value();
@@ -657,7 +1822,9 @@ void VulkanEngine::init_vulkan() {
   _instance = vkb_inst.instance;
   _debug_messenger = vkb_inst.debug_messenger;
 
-  SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+  if (!_headless) {
+    SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+  }
 
   // vulkan 1.3 features
   VkPhysicalDeviceVulkan13Features features{
@@ -670,6 +1837,13 @@ void VulkanEngine::init_vulkan() {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
   features12.bufferDeviceAddress = true;
   features12.descriptorIndexing = true;
+  // the bindless heap
+  features12.runtimeDescriptorArray = true;
+  features12.descriptorBindingPartiallyBound = true;
+  features12.descriptorBindingSampledImageUpdateAfterBind = true;
+  features12.descriptorBindingUpdateUnusedWhilePending = true;
+  features12.shaderSampledImageArrayNonUniformIndexing = true;
+  features12.timelineSemaphore = true;
 
   // Check for ray tracing extensions
   std::vector<const char *> required_extensions = {
@@ -678,47 +1852,180 @@ void VulkanEngine::init_vulkan() {
       VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
       VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME};
 
+  // software rasterizers like lavapipe have no ray tracing support, and
+  // nothing in the renderer uses it yet
+  if (_headless) {
+    required_extensions = {VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME};
+  }
+
   // use vkbootstrap to select a gpu.
   // We want a gpu that can write to the SDL surface and supports vulkan 1.3
   // with the correct features
   vkb::PhysicalDeviceSelector selector{vkb_inst};
-  vkb::PhysicalDevice physicalDevice =
-      selector.set_minimum_version(1, 3)
-          .add_required_extensions(required_extensions)
-          .set_required_features_13(features)
-          .set_required_features_12(features12)
-          .set_surface(_surface)
-          .select()
-          .value();
+  selector.set_minimum_version(1, 3)
+      .add_required_extensions(required_extensions)
+      .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+      .add_desired_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)
+      .set_required_features_13(features)
+      .set_required_features_12(features12);
+
+  if (!_headless) {
+    selector.set_surface(_surface);
+  }
+
+  vkb::PhysicalDevice physicalDevice = selector.select().value();
+
+  _timestampPeriod = physicalDevice.properties.limits.timestampPeriod;
+  _bufferOffsetAlignment = std::max(
+      physicalDevice.properties.limits.minUniformBufferOffsetAlignment,
+      physicalDevice.properties.limits.minStorageBufferOffsetAlignment);
+
+  // pipeline statistics are optional, enable them where the gpu has them.
+  // the device builder enables whatever is set in physicalDevice.features
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice.physical_device,
+                              &supportedFeatures);
+  _pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery;
+  _inheritedQueriesSupported =
+      _pipelineStatisticsSupported && supportedFeatures.inheritedQueries;
+  physicalDevice.features.pipelineStatisticsQuery =
+      _pipelineStatisticsSupported;
+  physicalDevice.features.inheritedQueries = _inheritedQueriesSupported;
+
+  // the geometry pass binds its descriptors from descriptor buffers where
+  // the gpu has them and their limits fit, descriptor pools otherwise
+  _descriptorBuffers =
+      _descriptorBuffersAllowed &&
+      DescriptorBufferDevice::supported(
+          physicalDevice.physical_device, FRAME_DESCRIPTOR_BUFFER_SIZE,
+          MAX_FRAMES_IN_FLIGHT, BINDLESS_IMAGES, BINDLESS_SAMPLERS);
 
   // create the final vulkan device
   vkb::DeviceBuilder deviceBuilder{physicalDevice};
 
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT};
+  descriptorBufferFeatures.descriptorBuffer = true;
+  if (_descriptorBuffers) {
+    deviceBuilder.add_pNext(&descriptorBufferFeatures);
+  }
+
   vkb::Device vkbDevice = deviceBuilder.build().value();
 
   // Get the VkDevice handle used in the rest of a vulkan application
   _device = vkbDevice.device;
   _chosenGPU = physicalDevice.physical_device;
 
+  if (_descriptorBuffers) {
+    _descriptorBufferDevice.init(_device, _chosenGPU);
+  }
+  fmt::print("\nengine.cpp init_vulkan() descriptor buffers: {}",
+             _descriptorBuffers);
+
   // use vkbootstrap to get a Graphics queue
   _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
   _graphicsQueueFamily =
       vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
   fmt::print("\nengine.cpp init_vulkan() _graphicsQueueFamily: {}",
              _graphicsQueueFamily);
+  _timestampsSupported =
+      physicalDevice.get_queue_families()[_graphicsQueueFamily]
+          .timestampValidBits > 0;
+  fmt::print("\nengine.cpp init_vulkan() gpu timing: {}",
+             _timestampsSupported);
+
+  // vkbootstrap hands out a compute queue from a family other than graphics,
+  // preferring a dedicated one. without one everything stays on graphics
+  auto computeQueue = vkbDevice.get_queue(vkb::QueueType::compute);
+  auto computeQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::compute);
+  if (_asyncComputeAllowed && computeQueue && computeQueueFamily) {
+    _computeQueue = computeQueue.value();
+    _computeQueueFamily = computeQueueFamily.value();
+    _asyncCompute = true;
+    _computeTimestampsSupported =
+        physicalDevice.get_queue_families()[_computeQueueFamily]
+            .timestampValidBits > 0;
+  }
+  fmt::print("\nengine.cpp init_vulkan() async compute: {}", _asyncCompute);
+  if (_asyncCompute) {
+    fmt::print(" (queue family {})", _computeQueueFamily);
+  }
 
   // initialize the memory allocator
   VmaAllocatorCreateInfo allocatorInfo = {};
   allocatorInfo.physicalDevice = _chosenGPU;
   allocatorInfo.device = _device;
   allocatorInfo.instance = _instance;
+  allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
   allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+  // the desired extension got enabled if the device has it
+  bool memoryBudget = MemoryTelemetry::budget_extension_supported(_chosenGPU);
+  if (memoryBudget) {
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
   vmaCreateAllocator(&allocatorInfo, &_allocator);
 
   _mainDeletionQueue.push_function([&]() { vmaDestroyAllocator(_allocator); });
+
+  _memoryTelemetry.init(_allocator, memoryBudget);
+  fmt::print("\nengine.cpp init_vulkan() memory budget extension: {}",
+             memoryBudget);
+  // nothing streams yet, so going over budget is only reported. a
+  // streaming system would drop mips or delay loads here
+  _memoryTelemetry.set_budget_callback(0.9f, [](const HeapBudget &heap) {
+    fmt::println("memory heap {} at {:.1f} of {:.1f} MiB budget", heap.heap,
+                 heap.usage / (1024.0 * 1024.0),
+                 heap.budget / (1024.0 * 1024.0));
+  });
+
+  _retirement.init(_device, _allocator, &_memoryTelemetry);
+  // a pass copies at most 64 MiB, in up to 64 moves
+  _defragmenter.init(_device, _allocator, 64 * 1024 * 1024, 64);
+
+  // vkbootstrap's transfer queue comes from a family other than graphics.
+  // uploads fall back to the graphics queue, still without blocking
+  auto transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+  auto transferQueueFamily =
+      vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+  if (!transferQueue || !transferQueueFamily) {
+    transferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+    transferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer);
+  }
+  if (transferQueue && transferQueueFamily) {
+    _transferQueue = transferQueue.value();
+    _transferQueueFamily = transferQueueFamily.value();
+  } else {
+    _transferQueue = _graphicsQueue;
+    _transferQueueFamily = _graphicsQueueFamily;
+  }
+  fmt::print("\nengine.cpp init_vulkan() _transferQueueFamily: {}",
+             _transferQueueFamily);
+
+  // staging for the uploads of a whole glTF, larger ones flush midway
+  _uploads.init(_device, _allocator, _transferQueue, _transferQueueFamily,
+                _graphicsQueueFamily, 32 * 1024 * 1024, &_memoryTelemetry);
+  _mainDeletionQueue.push_function([this]() { _uploads.cleanup(); });
+
+  // uploads write the pool on the transfer queue while graphics draws from
+  // it. a block fits about 1M vertices and 4M indices
+  uint32_t geometryFamilies[2] = {_graphicsQueueFamily, _transferQueueFamily};
+  _geometry.init(_device, _allocator, geometryFamilies, 1 << 20, 1 << 22,
+                 &_memoryTelemetry);
+  _mainDeletionQueue.push_function([this]() { _geometry.cleanup(); });
+
+  // grows by doubling, 1024 records are 32 KiB
+  _materialTable.init(_device, _allocator, 1024, &_retirement);
+  _mainDeletionQueue.push_function([this]() { _materialTable.cleanup(); });
 }
 
 void VulkanEngine::init_swapchain() {
+  if (_headless) {
+    // no swapchain, frames stay in the draw image
+    _swapchainExtent = _drawExtent;
+    return;
+  }
+
   create_swapchain(_drawExtent.width, _drawExtent.height);
 }
 
@@ -728,7 +2035,7 @@ void VulkanEngine::init_commands() {
   VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(
       _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-  for (int i = 0; i < FRAME_OVERLAP; i++) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 
     VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
                                  &_frames[i]._commandPool));
@@ -739,70 +2046,81 @@ void VulkanEngine::init_commands() {
 
     VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo,
                                       &_frames[i]._mainCommandBuffer));
-  }
-
-  // draw image size will match the window
-  VkExtent3D drawImageExtent = {_drawExtent.width, _drawExtent.height, 1};
-
-  // hardcoding the draw format to 32 bit float
-  _drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-  _drawImage.imageExtent = drawImageExtent;
-
-  VkImageUsageFlags drawImageUsages{};
-  drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-  drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-  drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
-  drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-  VkImageCreateInfo rimg_info = vkinit::image_create_info(
-      _drawImage.imageFormat, drawImageUsages, drawImageExtent);
-
-  // for the draw image, we want to allocate it from gpu local memory
-  VmaAllocationCreateInfo rimg_allocinfo = {};
-  rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  rimg_allocinfo.requiredFlags =
-      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  // allocate and create the image
-  vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &_drawImage.image,
-                 &_drawImage.allocation, nullptr);
-
-  // build a image-view for the draw image to use for rendering
-  VkImageViewCreateInfo rview_info = vkinit::imageview_create_info(
-      _drawImage.imageFormat, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
-
-  VK_CHECK(
-      vkCreateImageView(_device, &rview_info, nullptr, &_drawImage.imageView));
-
-  // depth image
-  _depthImage.imageFormat = VK_FORMAT_D32_SFLOAT;
-  _depthImage.imageExtent = drawImageExtent;
-  VkImageUsageFlags depthImageUsages{};
-  depthImageUsages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-  VkImageCreateInfo dimg_info = vkinit::image_create_info(
-      _depthImage.imageFormat, depthImageUsages, drawImageExtent);
+    // the recording pools are only ever reset as a whole
+    VkCommandPoolCreateInfo recordPoolInfo =
+        vkinit::command_pool_create_info(_graphicsQueueFamily);
+    for (int t = 0; t < MAX_RECORD_THREADS; t++) {
+      VK_CHECK(vkCreateCommandPool(_device, &recordPoolInfo, nullptr,
+                                   &_frames[i]._recordPools[t]));
+
+      VkCommandBufferAllocateInfo recordAllocInfo =
+          vkinit::command_buffer_allocate_info(
+              _frames[i]._recordPools[t], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+      VK_CHECK(vkAllocateCommandBuffers(_device, &recordAllocInfo,
+                                        &_frames[i]._recordBuffers[t]));
+    }
 
-  // allocate and create the image
-  vmaCreateImage(_allocator, &dimg_info, &rimg_allocinfo, &_depthImage.image,
-                 &_depthImage.allocation, nullptr);
+    // a block fits a few thousand uniform structs before it chains another
+    _frames[i]._frameAllocator.init(_allocator, 256 * 1024,
+                                    _bufferOffsetAlignment,
+                                    &_memoryTelemetry);
+    _mainDeletionQueue.push_function(
+        [this, i]() { _frames[i]._frameAllocator.cleanup(); });
 
-  // build a image-view for the draw image to use for rendering
-  VkImageViewCreateInfo dview_info = vkinit::imageview_create_info(
-      _depthImage.imageFormat, _depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT);
+    VkQueryPoolCreateInfo queryPoolInfo = vkinit::query_pool_create_info(
+        VK_QUERY_TYPE_TIMESTAMP, GPU_TIMESTAMP_COUNT);
+    if (_timestampsSupported) {
+      VK_CHECK(vkCreateQueryPool(_device, &queryPoolInfo, nullptr,
+                                 &_frames[i]._timestamps.pool));
+    }
 
-  VK_CHECK(
-      vkCreateImageView(_device, &dview_info, nullptr, &_depthImage.imageView));
+    if (_pipelineStatisticsSupported) {
+      VkQueryPoolCreateInfo statisticsPoolInfo = vkinit::query_pool_create_info(
+          VK_QUERY_TYPE_PIPELINE_STATISTICS, GPU_PASS_COUNT);
+      statisticsPoolInfo.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+      VK_CHECK(vkCreateQueryPool(_device, &statisticsPoolInfo, nullptr,
+                                 &_frames[i]._statistics.pool));
+    }
 
-  // add depth imag to deletion queue
-  _mainDeletionQueue.push_function([=]() {
-    vkDestroyImageView(_device, _drawImage.imageView, nullptr);
-    vmaDestroyImage(_allocator, _drawImage.image, _drawImage.allocation);
+    if (_asyncCompute) {
+      VkCommandPoolCreateInfo computePoolInfo =
+          vkinit::command_pool_create_info(
+              _computeQueueFamily,
+              VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+      VK_CHECK(vkCreateCommandPool(_device, &computePoolInfo, nullptr,
+                                   &_frames[i]._computePool));
+
+      VkCommandBufferAllocateInfo computeAllocInfo =
+          vkinit::command_buffer_allocate_info(_frames[i]._computePool, 1);
+      VK_CHECK(vkAllocateCommandBuffers(_device, &computeAllocInfo,
+                                        &_frames[i]._computeCommandBuffer));
+
+      if (_computeTimestampsSupported) {
+        VK_CHECK(vkCreateQueryPool(_device, &queryPoolInfo, nullptr,
+                                   &_frames[i]._computeTimestamps.pool));
+      }
+    }
+  }
 
-    vkDestroyImageView(_device, _depthImage.imageView, nullptr);
-    vmaDestroyImage(_allocator, _depthImage.image, _depthImage.allocation);
+  // draw image size will match the window
+  create_draw_targets(_drawExtent);
+
+  // destroys whatever draw targets are current at shutdown, replaced ones
+  // are retired when they get resized
+  _mainDeletionQueue.push_function([=, this]() {
+    destroy_image(_drawImage);
+    if (_asyncCompute) {
+      destroy_image(_backDrawImage);
+    }
   });
 
+  // transient placements replaced while frames are in flight are retired
+  // with the newest submitted frame, like resized draw targets
+  _transientAllocator.init(_device, _allocator, &_retirement,
+                           &_memoryTelemetry);
+  _mainDeletionQueue.push_function([this]() { _transientAllocator.cleanup(); });
+
   VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
                                &_immCommandPool));
 
@@ -819,18 +2137,26 @@ void VulkanEngine::init_commands() {
 
 void VulkanEngine::init_sync_structures() {
   // create syncronization structures
-  // one fence to control when the gpu has finished rendering the frame,
-  // and 2 semaphores to syncronize rendering with swapchain
-  // we want the fence to start signalled so we can wait on it on the first
-  // frame
+  // one timeline semaphore that every frame signals with its frame number, so
+  // the cpu knows when a frame slot can be reused,
+  // and 2 semaphores per frame to syncronize rendering with swapchain
+  VkSemaphoreTypeCreateInfo timelineCreateInfo =
+      vkinit::semaphore_type_create_info(VK_SEMAPHORE_TYPE_TIMELINE, 0);
+  VkSemaphoreCreateInfo frameTimelineInfo = vkinit::semaphore_create_info();
+  frameTimelineInfo.pNext = &timelineCreateInfo;
+  VK_CHECK(
+      vkCreateSemaphore(_device, &frameTimelineInfo, nullptr, &_frameTimeline));
+  if (_asyncCompute) {
+    VK_CHECK(vkCreateSemaphore(_device, &frameTimelineInfo, nullptr,
+                               &_computeTimeline));
+  }
+
+  // we want the immediate submit fence to start signalled
   VkFenceCreateInfo fenceCreateInfo =
       vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
   VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
 
-  for (int i = 0; i < FRAME_OVERLAP; i++) {
-    VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr,
-                           &_frames[i]._renderFence));
-
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr,
                                &_frames[i]._swapchainSemaphore));
     VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr,
@@ -850,6 +2176,12 @@ void VulkanEngine::init_descriptors() {
 
   globalDescriptorAllocator.init(_device, 10, sizes);
 
+  // every texture and sampler the materials sample
+  _bindless.init(_device, _chosenGPU, BINDLESS_IMAGES, BINDLESS_SAMPLERS,
+                 _descriptorBuffers ? &_descriptorBufferDevice : nullptr,
+                 _allocator);
+  _mainDeletionQueue.push_function([this]() { _bindless.cleanup(); });
+
   // make the descriptor set layout for our compute draw
   {
     DescriptorLayoutBuilder builder;
@@ -866,36 +2198,47 @@ void VulkanEngine::init_descriptors() {
   {
     DescriptorLayoutBuilder builder;
     builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    // the material table
+    builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
     _gpuSceneDataDescriptorLayout = builder.build(
-        _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        nullptr,
+        _descriptorBuffers
+            ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+            : 0);
+    // the set is written every frame
+    if (_descriptorBuffers) {
+      _sceneDescriptorBufferTemplate = builder.build_buffer_template(
+          _device, _gpuSceneDataDescriptorLayout, _descriptorBufferDevice);
+    } else {
+      _sceneDescriptorTemplate =
+          builder.build_template(_device, _gpuSceneDataDescriptorLayout);
+    }
   }
   // allocate a descriptor set for our draw image
-  _drawImageDescriptors =
-      globalDescriptorAllocator.allocate(_device, _drawImageDescriptorLayout);
-
-  {
-    DescriptorWriter writer;
-    writer.write_image(0, _drawImage.imageView, VK_NULL_HANDLE,
-                       VK_IMAGE_LAYOUT_GENERAL,
-                       VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-
-    writer.update_set(_device, _drawImageDescriptors);
-  }
+  write_draw_image_descriptors();
 
   // make sure both the descriptor allocator and the new layout get cleaned up
   // properly
   _mainDeletionQueue.push_function([&]() {
     globalDescriptorAllocator.destroy_pools(_device);
+    vkDestroyDescriptorPool(_device, _drawImageDescriptorPool, nullptr);
 
+    unregister_descriptor_layout(_drawImageDescriptorLayout);
     vkDestroyDescriptorSetLayout(_device, _drawImageDescriptorLayout, nullptr);
+    unregister_descriptor_layout(_singleImageDescriptorLayout);
     vkDestroyDescriptorSetLayout(_device, _singleImageDescriptorLayout,
                                  nullptr);
+    unregister_descriptor_layout(_gpuSceneDataDescriptorLayout);
     vkDestroyDescriptorSetLayout(_device, _gpuSceneDataDescriptorLayout,
                                  nullptr);
+    if (_sceneDescriptorTemplate.handle != VK_NULL_HANDLE) {
+      _sceneDescriptorTemplate.destroy(_device);
+    }
   });
 
   //> frame_desc
-  for (int i = 0; i < FRAME_OVERLAP; i++) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     // create a descriptor pool
     std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frame_sizes = {
         {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3},
@@ -904,23 +2247,42 @@ void VulkanEngine::init_descriptors() {
         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
     };
 
-    _frames[i]._frameDescriptors = DescriptorAllocatorGrowable{};
-    _frames[i]._frameDescriptors.init(_device, 1000, frame_sizes);
+    _frames[i]._frameDescriptors = DescriptorAllocatorPerThread{};
+    _frames[i]._frameDescriptors.init(_device, _jobs.thread_count(), 1000,
+                                      frame_sizes);
 
     _mainDeletionQueue.push_function(
         [&, i]() { _frames[i]._frameDescriptors.destroy_pools(_device); });
+
+    // the scene set of the geometry pass, with descriptor buffers
+    if (_descriptorBuffers) {
+      _frames[i]._frameDescriptorBuffer.init(
+          _device, _allocator, &_descriptorBufferDevice,
+          FRAME_DESCRIPTOR_BUFFER_SIZE,
+          VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT);
+      _mainDeletionQueue.push_function([&, i]() {
+        _frames[i]._frameDescriptorBuffer.destroy(_allocator);
+      });
+    }
   }
   //< frame_desc
 }
 
 void VulkanEngine::init_pipelines() {
+  // the pipelines don't depend on each other and building them is mostly the
+  // driver compiling shaders, so they are built as jobs side by side
+  JobCounter pipelinesBuilt;
+
   // COMPUTE PIPELINES
-  init_background_pipelines();
+  _jobs.run([this]() { init_background_pipelines(); }, &pipelinesBuilt);
 
   // GRAPHICS PIPELINES
-  init_mesh_pipeline();
+  _jobs.run([this]() { init_mesh_pipeline(); }, &pipelinesBuilt);
+
+  _jobs.run([this]() { metalRoughMaterial.build_pipelines(this); },
+            &pipelinesBuilt);
 
-  metalRoughMaterial.build_pipelines(this);
+  _jobs.wait(pipelinesBuilt);
   //_mainDeletionQueue.push_function([&]() {
   //  vkDestroyPipelineLayout(_device, metalRoughMaterial.opaquePipeline.layout,
   //                          nullptr);
@@ -1086,9 +2448,39 @@ void VulkanEngine::init_imgui() {
 }
 
 void VulkanEngine::update_scene() {
+  PROFILE_FUNCTION();
   mainDrawContext.OpaqueSurfaces.clear();
 
-  loadedNodes["Suzanne"]->Draw(glm::mat4{1.f}, mainDrawContext);
+  // the first copy sits at the origin, the others fill a grid behind it.
+  // batches of copies are traversed as jobs, each into its own draw list,
+  // and appended in order so the draw order doesn't depend on the threads
+  constexpr uint32_t copiesPerBatch = 64;
+  std::shared_ptr<Node> sceneRoot = loadedNodes["Suzanne"];
+  uint32_t gridSize =
+      static_cast<uint32_t>(std::ceil(std::sqrt(float(_sceneCopies))));
+  uint32_t batchCount = (_sceneCopies + copiesPerBatch - 1) / copiesPerBatch;
+  if (_sceneBatchContexts.size() < batchCount) {
+    _sceneBatchContexts.resize(batchCount);
+  }
+
+  _jobs.parallel_for(
+      _sceneCopies, copiesPerBatch, [&](uint32_t begin, uint32_t end) {
+        DrawContext &ctx = _sceneBatchContexts[begin / copiesPerBatch];
+        ctx.OpaqueSurfaces.clear();
+        for (uint32_t i = begin; i < end; i++) {
+          glm::vec3 offset{float(i % gridSize) * 3.f, 0.f,
+                           -float(i / gridSize) * 3.f};
+          sceneRoot->Draw(glm::translate(offset), ctx);
+        }
+      });
+
+  for (uint32_t i = 0; i < batchCount; i++) {
+    std::vector<RenderObject> &surfaces =
+        _sceneBatchContexts[i].OpaqueSurfaces;
+    mainDrawContext.OpaqueSurfaces.insert(
+        mainDrawContext.OpaqueSurfaces.end(), surfaces.begin(),
+        surfaces.end());
+  }
 
   mainCamera.update();
 
@@ -1138,19 +2530,19 @@ void VulkanEngine::init_default_data() {
 
   // 3 default textures, white, grey, black. 1 pixel each
   uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
-  _whiteImage =
+  _whiteImage = add_image(
       create_image((void *)&white, VkExtent3D{1, 1, 1},
-                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT));
 
   uint32_t grey = glm::packUnorm4x8(glm::vec4(0.66f, 0.66f, 0.66f, 1));
-  _greyImage =
-      create_image((void *)&grey, VkExtent3D{1, 1, 1}, VK_FORMAT_R8G8B8A8_UNORM,
-                   VK_IMAGE_USAGE_SAMPLED_BIT);
+  _greyImage = add_image(
+      create_image((void *)&grey, VkExtent3D{1, 1, 1},
+                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT));
 
   uint32_t black = glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
-  _blackImage =
+  _blackImage = add_image(
       create_image((void *)&black, VkExtent3D{1, 1, 1},
-                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT));
 
   // checkerboard image
   uint32_t magenta = glm::packUnorm4x8(glm::vec4(1, 0, 1, 1));
@@ -1160,9 +2552,14 @@ void VulkanEngine::init_default_data() {
       pixels[y * 16 + x] = ((x % 2) ^ (y % 2)) ? magenta : black;
     }
   }
-  _errorCheckerboardImage =
+  _errorCheckerboardImage = add_image(
       create_image(pixels.data(), VkExtent3D{16, 16, 1},
-                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+                   VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT));
+  // images that don't fit the bindless heap sample the checkerboard. its
+  // slot has to stay put, so it is never defragmented
+  const AllocatedImage &checkerboard = _images.get(_errorCheckerboardImage);
+  _bindless.set_fallback_image(checkerboard.bindlessIndex);
+  set_defrag_owner(_allocator, checkerboard.allocation, DefragOwner::None, 0);
 
   VkSamplerCreateInfo sampl = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
 
@@ -1179,10 +2576,8 @@ void VulkanEngine::init_default_data() {
     vkDestroySampler(_device, _defaultSamplerNearest, nullptr);
     vkDestroySampler(_device, _defaultSamplerLinear, nullptr);
 
-    destroy_image(_whiteImage);
-    destroy_image(_greyImage);
-    destroy_image(_blackImage);
-    destroy_image(_errorCheckerboardImage);
+    // the default images, material buffers and whatever else was pooled
+    destroy_pooled_resources();
   });
 
   testMeshes =
@@ -1195,27 +2590,11 @@ void VulkanEngine::init_default_data() {
   materialResources.metalRoughImage = _whiteImage;
   materialResources.metalRoughSampler = _defaultSamplerLinear;
 
-  // set the uniform buffer for the material data
-  AllocatedBuffer materialConstants = create_buffer(
-      sizeof(GLTFMetallic_Roughness::MaterialConstants),
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-  // write the buffer
-  GLTFMetallic_Roughness::MaterialConstants *sceneUniformData =
-      (GLTFMetallic_Roughness::MaterialConstants *)
-          materialConstants.allocation->GetMappedData();
-  sceneUniformData->colorFactors = glm::vec4{1, 1, 1, 1};
-  sceneUniformData->metal_rough_factors = glm::vec4{1, 0.5, 0, 0};
-
-  _mainDeletionQueue.push_function(
-      [=, this]() { destroy_buffer(materialConstants); });
-
-  materialResources.dataBuffer = materialConstants.buffer;
-  materialResources.dataBufferOffset = 0;
+  materialResources.constants.colorFactors = glm::vec4{1, 1, 1, 1};
+  materialResources.constants.metal_rough_factors = glm::vec4{1, 0.5, 0, 0};
 
   defaultData = metalRoughMaterial.write_material(
-      _device, MaterialPass::MainColor, materialResources,
-      globalDescriptorAllocator);
+      this, MaterialPass::MainColor, materialResources);
 
   for (auto &m : testMeshes) {
     std::shared_ptr<MeshNode> newNode = std::make_shared<MeshNode>();
@@ -1232,21 +2611,25 @@ void VulkanEngine::init_default_data() {
   }
 }
 
-void VulkanEngine::create_swapchain(uint32_t width, uint32_t height) {
+void VulkanEngine::create_swapchain(uint32_t width, uint32_t height,
+                                    VkSwapchainKHR oldSwapchain) {
   vkb::SwapchainBuilder swapchainBuilder{_chosenGPU, _device, _surface};
 
   _swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 
+  _presentMode = choose_present_mode(_chosenGPU, _surface, _presentPolicy);
+
   vkb::Swapchain vkbSwapchain =
       swapchainBuilder
           //.use_default_format_selection()
           .set_desired_format(VkSurfaceFormatKHR{
               .format = _swapchainImageFormat,
               .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-          // use vsync present mode
-          .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+          // already resolved to a mode the surface supports
+          .set_desired_present_mode(_presentMode)
           .set_desired_extent(width, height)
           .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+          .set_old_swapchain(oldSwapchain)
           .build()
           .value();
 
@@ -1269,7 +2652,8 @@ void VulkanEngine::destroy_swapchain() {
 
 AllocatedBuffer VulkanEngine::create_buffer(size_t allocSize,
                                             VkBufferUsageFlags usage,
-                                            VmaMemoryUsage memoryUsage) {
+                                            VmaMemoryUsage memoryUsage,
+                                            MemoryCategory category) {
   // allocate buffer
   VkBufferCreateInfo bufferInfo = {.sType =
                                        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
@@ -1282,16 +2666,22 @@ AllocatedBuffer VulkanEngine::create_buffer(size_t allocSize,
   vmaallocInfo.usage = memoryUsage;
   vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
   AllocatedBuffer newBuffer;
+  newBuffer.usage = usage;
+  newBuffer.size = allocSize;
 
   // allocate the buffer
   VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
                            &newBuffer.buffer, &newBuffer.allocation,
                            &newBuffer.info));
+  _bufferAllocations++;
+  _retirement.track(ResourceType::Buffer, resource_handle(newBuffer.buffer),
+                    newBuffer.info.size, category);
 
   return newBuffer;
 }
 
 void VulkanEngine::destroy_buffer(const AllocatedBuffer &buffer) {
+  _retirement.untrack(resource_handle(buffer.buffer));
   vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 }
 
@@ -1302,75 +2692,221 @@ GPUMeshBuffers VulkanEngine::uploadMesh(std::span<uint32_t> indices,
 
   GPUMeshBuffers newSurface;
 
-  // create vertex buffer
-  newSurface.vertexBuffer = create_buffer(
-      vertexBufferSize,
-      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-      VMA_MEMORY_USAGE_GPU_ONLY);
+  // suballocate the vertices and indices from the geometry pool
+  newSurface.geometry =
+      _geometry.allocate(static_cast<uint32_t>(vertices.size()),
+                         static_cast<uint32_t>(indices.size()));
+  const GeometryRange &geometry = newSurface.geometry;
 
-  // find the adress of the vertex buffer
-  VkBufferDeviceAddressInfo deviceAdressInfo{
-      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-      .buffer = newSurface.vertexBuffer.buffer};
-  newSurface.vertexBufferAddress =
-      vkGetBufferDeviceAddress(_device, &deviceAdressInfo);
+  // reused by the upload queue once the copies have finished
+  StagingAllocation staging =
+      _uploads.stage(vertexBufferSize + indexBufferSize);
 
-  // create index buffer
-  newSurface.indexBuffer = create_buffer(indexBufferSize,
-                                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                         VMA_MEMORY_USAGE_GPU_ONLY);
-
-  AllocatedBuffer staging = create_buffer(vertexBufferSize + indexBufferSize,
-                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                          VMA_MEMORY_USAGE_CPU_ONLY);
-
-  void *data = staging.allocation->GetMappedData();
+  void *data = staging.data;
 
   // copy vertex buffer
   memcpy(data, vertices.data(), vertexBufferSize);
   // copy index buffer
   memcpy((char *)data + vertexBufferSize, indices.data(), indexBufferSize);
 
-  immediate_submit([&](VkCommandBuffer cmd) {
-    VkBufferCopy vertexCopy{0};
-    vertexCopy.dstOffset = 0;
-    vertexCopy.srcOffset = 0;
-    vertexCopy.size = vertexBufferSize;
-
-    vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1,
-                    &vertexCopy);
-
-    VkBufferCopy indexCopy{0};
-    indexCopy.dstOffset = 0;
-    indexCopy.srcOffset = vertexBufferSize;
-    indexCopy.size = indexBufferSize;
-
-    vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1,
-                    &indexCopy);
-  });
-
-  destroy_buffer(staging);
+  // the pool buffers are shared by the graphics and transfer families, so
+  // the frame's wait on the upload timeline is all the copies need. an
+  // ownership transfer would cover the whole buffer, which other meshes
+  // are drawn from
+  newSurface.upload = _uploads.record(
+      [&](VkCommandBuffer cmd) {
+        VkBufferCopy vertexCopy{0};
+        vertexCopy.dstOffset =
+            VkDeviceSize(geometry.vertexOffset) * sizeof(Vertex);
+        vertexCopy.srcOffset = staging.offset;
+        vertexCopy.size = vertexBufferSize;
+
+        vkCmdCopyBuffer(cmd, staging.buffer,
+                        _geometry.vertex_buffer(geometry.block), 1,
+                        &vertexCopy);
+
+        VkBufferCopy indexCopy{0};
+        indexCopy.dstOffset =
+            VkDeviceSize(geometry.firstIndex) * sizeof(uint32_t);
+        indexCopy.srcOffset = staging.offset + vertexBufferSize;
+        indexCopy.size = indexBufferSize;
+
+        vkCmdCopyBuffer(cmd, staging.buffer,
+                        _geometry.index_buffer(geometry.block), 1, &indexCopy);
+      },
+      {}, {});
 
   return newSurface;
 }
 
-void VulkanEngine::resize_swapchain() {
-  vkDeviceWaitIdle(_device);
-
-  destroy_swapchain();
+void VulkanEngine::destroy_mesh(const GPUMeshBuffers &mesh) {
+  _geometry.retire(mesh.geometry, _retirement.submitted_value());
+}
 
+void VulkanEngine::resize_swapchain() {
   int w, h;
   SDL_GetWindowSize(_window, &w, &h);
+  if (w == 0 || h == 0) {
+    // minimized, try again once the window has a size
+    return;
+  }
   _drawExtent.width = w;
   _drawExtent.height = h;
 
-  create_swapchain(_drawExtent.width, _drawExtent.height);
+  // the frames in flight still present from the old swapchain. hand it to
+  // the new one and retire it with the newest submitted frame instead of
+  // waiting for the device to go idle
+  VkSwapchainKHR oldSwapchain = _swapchain;
+  std::vector<VkImageView> oldImageViews = std::move(_swapchainImageViews);
+
+  create_swapchain(_drawExtent.width, _drawExtent.height, oldSwapchain);
+
+  for (VkImageView view : oldImageViews) {
+    _retirement.retire(ResourceType::ImageView, resource_handle(view));
+  }
+  _retirement.retire(ResourceType::Swapchain, resource_handle(oldSwapchain));
 
   resize_requested = false;
 }
 
+void VulkanEngine::create_draw_targets(VkExtent2D extent) {
+  VkExtent3D drawImageExtent = {extent.width, extent.height, 1};
+
+  _drawImage = create_draw_image(drawImageExtent);
+  if (_asyncCompute) {
+    _backDrawImage = create_draw_image(drawImageExtent);
+  }
+
+  if (_headless && _headlessReadback) {
+    // 8 bytes per RGBA16F pixel
+    size_t readbackSize = size_t(drawImageExtent.width) *
+                          drawImageExtent.height * sizeof(uint64_t);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      _frames[i]._readbackBuffer =
+          create_buffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Staging);
+    }
+  }
+}
+
+AllocatedImage VulkanEngine::create_draw_image(VkExtent3D extent) {
+  AllocatedImage drawImage;
+  // hardcoding the draw format to 32 bit float
+  drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+  drawImage.imageExtent = extent;
+
+  VkImageUsageFlags drawImageUsages{};
+  drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
+  drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+  VkImageCreateInfo rimg_info = vkinit::image_create_info(
+      drawImage.imageFormat, drawImageUsages, extent);
+
+  // the background writes it on the compute queue with async compute
+  uint32_t queueFamilies[2] = {_graphicsQueueFamily, _computeQueueFamily};
+  if (_asyncCompute) {
+    rimg_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    rimg_info.queueFamilyIndexCount = 2;
+    rimg_info.pQueueFamilyIndices = queueFamilies;
+  }
+
+  // for the draw image, we want to allocate it from gpu local memory
+  VmaAllocationCreateInfo rimg_allocinfo = {};
+  rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  rimg_allocinfo.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // allocate and create the image
+  VmaAllocationInfo allocationInfo;
+  vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &drawImage.image,
+                 &drawImage.allocation, &allocationInfo);
+  _retirement.track(ResourceType::Image, resource_handle(drawImage.image),
+                    allocationInfo.size, MemoryCategory::RenderTargets);
+
+  // build a image-view for the draw image to use for rendering
+  VkImageViewCreateInfo rview_info = vkinit::imageview_create_info(
+      drawImage.imageFormat, drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+
+  VK_CHECK(
+      vkCreateImageView(_device, &rview_info, nullptr, &drawImage.imageView));
+
+  return drawImage;
+}
+
+void VulkanEngine::resize_draw_targets(VkExtent2D requiredExtent) {
+  VkExtent3D current = _drawImage.imageExtent;
+
+  bool tooSmall = requiredExtent.width > current.width ||
+                  requiredExtent.height > current.height;
+  // give memory back once the targets are more than twice the needed area
+  bool tooLarge = uint64_t(current.width) * current.height >
+                  2 * uint64_t(requiredExtent.width) * requiredExtent.height;
+  if (!tooSmall && !tooLarge) {
+    return;
+  }
+
+  // the frames in flight may still render into the old targets, retire them
+  // with the newest submitted frame
+  _retirement.retire_image(_drawImage);
+  if (_asyncCompute) {
+    _retirement.retire_image(_backDrawImage);
+  }
+
+  if (_headless && _headlessReadback) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      _retirement.retire_buffer(_frames[i]._readbackBuffer);
+    }
+  }
+
+  // round up, so dragging a window edge does not reallocate every frame
+  constexpr uint32_t granularity = 128;
+  VkExtent2D newExtent = {
+      (requiredExtent.width + granularity - 1) / granularity * granularity,
+      (requiredExtent.height + granularity - 1) / granularity * granularity};
+
+  create_draw_targets(newExtent);
+
+  // the old descriptor sets may still be bound by a frame in flight, so
+  // point new ones at the new draw images instead of updating them
+  write_draw_image_descriptors();
+}
+
+void VulkanEngine::write_draw_image_descriptors() {
+  // frames in flight may still bind the old sets
+  if (_drawImageDescriptorPool != VK_NULL_HANDLE) {
+    _retirement.retire(ResourceType::DescriptorPool,
+                       resource_handle(_drawImageDescriptorPool),
+                       VK_NULL_HANDLE);
+  }
+
+  DescriptorAllocator pool;
+  DescriptorAllocator::PoolSizeRatio sizes[] = {
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}};
+  pool.init_pool(_device, 2, sizes);
+  _drawImageDescriptorPool = pool.pool;
+
+  _drawImageDescriptors = pool.allocate(_device, _drawImageDescriptorLayout);
+
+  DescriptorWriter writer;
+  writer.write_image(0, _drawImage.imageView, VK_NULL_HANDLE,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+  writer.update_set(_device, _drawImageDescriptors);
+
+  if (_asyncCompute) {
+    _backDrawImageDescriptors =
+        pool.allocate(_device, _drawImageDescriptorLayout);
+
+    DescriptorWriter backWriter;
+    backWriter.write_image(0, _backDrawImage.imageView, VK_NULL_HANDLE,
+                           VK_IMAGE_LAYOUT_GENERAL,
+                           VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    backWriter.update_set(_device, _backDrawImageDescriptors);
+  }
+}
+
 void GLTFMetallic_Roughness::build_pipelines(VulkanEngine *engine) {
   VkShaderModule meshFragShader;
   if (!vkutil::load_shader_module("../shaders/compiled/mesh.frag.spv",
@@ -1389,17 +2925,10 @@ void GLTFMetallic_Roughness::build_pipelines(VulkanEngine *engine) {
   matrixRange.size = sizeof(GPUDrawPushConstants);
   matrixRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-  DescriptorLayoutBuilder layoutBuilder;
-  layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-  layoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-  layoutBuilder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-
-  materialLayout =
-      layoutBuilder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT |
-                                               VK_SHADER_STAGE_FRAGMENT_BIT);
-
+  // the textures come from the bindless heap, every mesh pipeline shares
+  // the layout so the sets stay bound across pipeline switches
   VkDescriptorSetLayout layouts[] = {engine->_gpuSceneDataDescriptorLayout,
-                                     materialLayout};
+                                     engine->_bindless.layout()};
 
   VkPipelineLayoutCreateInfo mesh_layout_info =
       vkinit::pipeline_layout_create_info();
@@ -1428,11 +2957,16 @@ void GLTFMetallic_Roughness::build_pipelines(VulkanEngine *engine) {
 
   // render format
   pipelineBuilder.set_color_attachment_format(engine->_drawImage.imageFormat);
-  pipelineBuilder.set_depth_format(engine->_depthImage.imageFormat);
+  pipelineBuilder.set_depth_format(engine->_depthFormat);
 
   // use the triangle layout we created
   pipelineBuilder._pipelineLayout = newLayout;
 
+  if (engine->_descriptorBuffers) {
+    pipelineBuilder.set_create_flags(
+        VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+  }
+
   // finally build the pipeline
   opaquePipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
 
@@ -1449,16 +2983,18 @@ void GLTFMetallic_Roughness::build_pipelines(VulkanEngine *engine) {
 }
 
 void GLTFMetallic_Roughness::clear_resources(VkDevice device) {
-  vkDestroyDescriptorSetLayout(device, materialLayout, nullptr);
   vkDestroyPipelineLayout(device, transparentPipeline.layout, nullptr);
 
   vkDestroyPipeline(device, transparentPipeline.pipeline, nullptr);
   vkDestroyPipeline(device, opaquePipeline.pipeline, nullptr);
+
+  written.clear();
+  byImage.clear();
 }
 
-MaterialInstance GLTFMetallic_Roughness::write_material(
-    VkDevice device, MaterialPass pass, const MaterialResources &resources,
-    DescriptorAllocatorGrowable &descriptorAllocator) {
+MaterialHandle GLTFMetallic_Roughness::write_material(
+    VulkanEngine *engine, MaterialPass pass,
+    const MaterialResources &resources) {
   MaterialInstance matData;
   matData.passType = pass;
   if (pass == MaterialPass::Transparent) {
@@ -1467,23 +3003,77 @@ MaterialInstance GLTFMetallic_Roughness::write_material(
     matData.pipeline = &opaquePipeline;
   }
 
-  matData.materialSet = descriptorAllocator.allocate(device, materialLayout);
+  matData.materialIndex =
+      engine->_materialTable.add(material_record(engine, resources));
 
-  writer.clear();
-  writer.write_buffer(0, resources.dataBuffer, sizeof(MaterialConstants),
-                      resources.dataBufferOffset,
-                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-  writer.write_image(1, resources.colorImage.imageView, resources.colorSampler,
-                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-  writer.write_image(2, resources.metalRoughImage.imageView,
-                     resources.metalRoughSampler,
-                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+  MaterialHandle material = engine->_materials.add(matData);
+  written[material.value] = resources;
+  byImage[resources.colorImage.value].push_back(material);
+  if (resources.metalRoughImage != resources.colorImage) {
+    byImage[resources.metalRoughImage.value].push_back(material);
+  }
+  return material;
+}
 
-  writer.update_set(device, matData.materialSet);
+void GLTFMetallic_Roughness::update_constants(
+    VulkanEngine *engine, MaterialHandle material,
+    const GPUMaterialData &constants) {
+  auto it = written.find(material.value);
+  if (it == written.end()) {
+    return;
+  }
+  it->second.constants = constants;
+  engine->_materialTable.update(engine->_materials.get(material).materialIndex,
+                                material_record(engine, it->second));
+}
+
+void GLTFMetallic_Roughness::update_image(VulkanEngine *engine,
+                                          ImageHandle image) {
+  auto users = byImage.find(image.value);
+  if (users == byImage.end()) {
+    return;
+  }
+  for (MaterialHandle material : users->second) {
+    engine->_materialTable.update(
+        engine->_materials.get(material).materialIndex,
+        material_record(engine, written.at(material.value)));
+  }
+}
+
+void GLTFMetallic_Roughness::destroy_material(VulkanEngine *engine,
+                                              MaterialHandle material) {
+  auto it = written.find(material.value);
+  if (it == written.end()) {
+    return;
+  }
+  for (ImageHandle image :
+       {it->second.colorImage, it->second.metalRoughImage}) {
+    auto users = byImage.find(image.value);
+    if (users == byImage.end()) {
+      continue;
+    }
+    std::erase(users->second, material);
+    if (users->second.empty()) {
+      byImage.erase(users);
+    }
+  }
+  written.erase(it);
+
+  MaterialInstance instance = engine->_materials.remove(material);
+  engine->_materialTable.remove(instance.materialIndex);
+}
 
-  return matData;
+GPUMaterialData
+GLTFMetallic_Roughness::material_record(VulkanEngine *engine,
+                                        const MaterialResources &resources) {
+  GPUMaterialData record = resources.constants;
+  record.colorTexture = engine->_images.get(resources.colorImage).bindlessIndex;
+  record.colorSampler = engine->_bindless.sampler_index(resources.colorSampler);
+  record.metalRoughTexture =
+      engine->_images.get(resources.metalRoughImage).bindlessIndex;
+  record.metalRoughSampler =
+      engine->_bindless.sampler_index(resources.metalRoughSampler);
+  return record;
 }
 
 void MeshNode::Draw(const glm::mat4 &topMatrix, DrawContext &ctx) {
@@ -1492,12 +3082,14 @@ void MeshNode::Draw(const glm::mat4 &topMatrix, DrawContext &ctx) {
   for (auto &s : mesh->surfaces) {
     RenderObject def;
     def.indexCount = s.count;
-    def.firstIndex = s.startIndex;
-    def.indexBuffer = mesh->meshBuffers.indexBuffer.buffer;
-    def.material = &s.material->data;
+    def.firstIndex = mesh->meshBuffers.geometry.firstIndex + s.startIndex;
+    def.vertexOffset =
+        static_cast<int32_t>(mesh->meshBuffers.geometry.vertexOffset);
+    def.geometryBlock = mesh->meshBuffers.geometry.block;
+    def.material = s.material->data;
 
     def.transform = nodeMatrix;
-    def.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress;
+    def.upload = mesh->meshBuffers.upload;
 
     ctx.OpaqueSurfaces.push_back(def);
   }
@@ -3,8 +3,21 @@
 
 #pragma once
 #include <camera.h>
+#include <vk_gpu_profiler.h>
+#include <job_system.h>
 #include <vk_descriptors.h>
+#include <vk_linear_allocator.h>
+#include <vk_geometry_pool.h>
+#include <vk_retirement.h>
+#include <vk_memory_telemetry.h>
+#include <vk_handle_pool.h>
+#include <vk_defragmenter.h>
+#include <vk_material_table.h>
+#include <vk_bindless.h>
 #include <vk_loader.h>
+#include <vk_presentation.h>
+#include <vk_render_graph.h>
+#include <vk_upload.h>
 #include <vk_types.h>
 
 struct MeshNode : public Node {
@@ -16,39 +29,67 @@ struct MeshNode : public Node {
 
 struct RenderObject {
   uint32_t indexCount;
+  // into the geometry pool block, firstIndex and vertexOffset already
+  // include the mesh's range
   uint32_t firstIndex;
-  VkBuffer indexBuffer;
+  int32_t vertexOffset;
+  uint32_t geometryBlock;
 
-  MaterialInstance *material;
+  MaterialHandle material;
 
   glm::mat4 transform;
-  VkDeviceAddress vertexBufferAddress;
+  // the mesh upload, the draw is skipped until it is ready
+  UploadTicket upload;
 };
 
 struct DrawContext {
   std::vector<RenderObject> OpaqueSurfaces;
 };
 
+// commands draw_geometry recorded in a frame
+struct DrawCounters {
+  uint32_t draws{0};
+  uint32_t pipelineBinds{0};
+  uint32_t descriptorSetBinds{0};
+  uint32_t pushConstantUpdates{0};
+  uint32_t indexBufferBinds{0};
+  uint64_t triangles{0};
+
+  void add(const DrawCounters &other) {
+    draws += other.draws;
+    pipelineBinds += other.pipelineBinds;
+    descriptorSetBinds += other.descriptorSetBinds;
+    pushConstantUpdates += other.pushConstantUpdates;
+    indexBufferBinds += other.indexBufferBinds;
+    triangles += other.triangles;
+  }
+};
+
+struct FrameStats {
+  // of the frame recorded last
+  DrawCounters cpu;
+  // of the frame that retired last. stays zero on devices without
+  // pipelineStatisticsQuery
+  PipelineStatistics gpu;
+
+  // per frame data bump allocated from the slot's linear allocator
+  uint32_t linearAllocations{0};
+  VkDeviceSize linearBytes{0};
+  // buffers created with vma during the frame
+  uint32_t bufferAllocations{0};
+};
+
 struct GLTFMetallic_Roughness {
   MaterialPipeline opaquePipeline;
   MaterialPipeline transparentPipeline;
 
-  VkDescriptorSetLayout materialLayout;
-
-  struct MaterialConstants {
-    glm::vec4 colorFactors;
-    glm::vec4 metal_rough_factors;
-    // padding, we need it anyway for uniform buffers
-    glm::vec4 extra[14];
-  };
-
+  // images in the engine's pool, the constants go to the material table
   struct MaterialResources {
-    AllocatedImage colorImage;
+    ImageHandle colorImage;
     VkSampler colorSampler;
-    AllocatedImage metalRoughImage;
+    ImageHandle metalRoughImage;
     VkSampler metalRoughSampler;
-    VkBuffer dataBuffer;
-    uint32_t dataBufferOffset;
+    GPUMaterialData constants;
   };
 
   DescriptorWriter writer;
@@ -56,10 +97,29 @@ struct GLTFMetallic_Roughness {
   void build_pipelines(VulkanEngine *engine);
   void clear_resources(VkDevice device);
 
-  MaterialInstance
-  write_material(VkDevice device, MaterialPass pass,
-                 const MaterialResources &resources,
-                 DescriptorAllocatorGrowable &descriptorAllocator);
+  // the material is added to the engine's material pool, its record to
+  // the material table. the record references the textures and samplers
+  // by their bindless slots
+  MaterialHandle write_material(VulkanEngine *engine, MaterialPass pass,
+                                const MaterialResources &resources);
+  // only the material's record in the table is copied again
+  void update_constants(VulkanEngine *engine, MaterialHandle material,
+                        const GPUMaterialData &constants);
+  // points the records of the materials using the image at its current
+  // bindless slot
+  void update_image(VulkanEngine *engine, ImageHandle image);
+  // removes the material and its record, once no draw uses it anymore
+  void destroy_material(VulkanEngine *engine, MaterialHandle material);
+
+  // every live material, by handle value, with the resources its record
+  // points at
+  std::unordered_map<uint32_t, MaterialResources> written;
+  // the materials using each image, by image handle value
+  std::unordered_map<uint32_t, std::vector<MaterialHandle>> byImage;
+
+private:
+  GPUMaterialData material_record(VulkanEngine *engine,
+                                  const MaterialResources &resources);
 };
 
 struct GPUSceneData {
@@ -89,8 +149,11 @@ struct ComputeEffect {
 
 struct DeletionQueue {
   std::deque<std::function<void()>> deletors;
+  // init work running as jobs pushes from several threads
+  std::mutex mutex;
 
   void push_function(std::function<void()> &&function) {
+    std::lock_guard<std::mutex> lock(mutex);
     deletors.push_back(function);
   }
 
@@ -105,16 +168,66 @@ struct DeletionQueue {
   }
 };
 
+// upper bound for the threads recording draw_geometry, main thread included
+constexpr unsigned int MAX_RECORD_THREADS = 16;
+
+// slots of the bindless heap, and the size of each frame slot's descriptor
+// buffer for the geometry pass's scene set
+constexpr uint32_t BINDLESS_IMAGES = 16384;
+constexpr uint32_t BINDLESS_SAMPLERS = 64;
+constexpr VkDeviceSize FRAME_DESCRIPTOR_BUFFER_SIZE = 64 * 1024;
+
+// the geometry pass's scene set, a pool set or an offset into the frame's
+// descriptor buffer
+struct SceneDescriptor {
+  VkDescriptorSet set{VK_NULL_HANDLE};
+  VkDeviceSize bufferOffset{0};
+};
+
+// the scene set's bindings, in the order of its update template
+struct SceneDescriptorData {
+  VkDescriptorBufferInfo sceneData;
+  VkDescriptorBufferInfo materialTable;
+};
+
 struct FrameData {
   VkSemaphore _swapchainSemaphore, _renderSemaphore;
-  VkFence _renderFence;
+  // value of the frame timeline that marks this slot's last frame as finished
+  uint64_t _timelineValue{0};
   VkCommandPool _commandPool;
   VkCommandBuffer _mainCommandBuffer;
-  DeletionQueue _deletionQueue;
-  DescriptorAllocatorGrowable _frameDescriptors;
+  // one allocator per job system thread, reset when the slot is reused
+  DescriptorAllocatorPerThread _frameDescriptors;
+  // the same for the geometry pass when it binds descriptor buffers
+  DescriptorBufferAllocator _frameDescriptorBuffer;
+  // uniforms and other data the frame writes once and the gpu reads
+  LinearAllocator _frameAllocator;
+
+  // one pool per geometry recording thread, each with a secondary command
+  // buffer. the pools get reset as a whole when the slot is reused
+  VkCommandPool _recordPools[MAX_RECORD_THREADS];
+  VkCommandBuffer _recordBuffers[MAX_RECORD_THREADS];
+  uint32_t _recordBuffersUsed{0};
+
+  // per pass timestamps, read back once the frame has finished
+  GpuTimestampQueries _timestamps;
+  GpuStatisticsQueries _statistics;
+
+  // async compute only: the background, recorded for the compute queue.
+  // the statistics stay without a pool, graphics statistics can't be
+  // queried on a compute queue
+  VkCommandPool _computePool{VK_NULL_HANDLE};
+  VkCommandBuffer _computeCommandBuffer{VK_NULL_HANDLE};
+  GpuTimestampQueries _computeTimestamps;
+  GpuStatisticsQueries _computeStatistics;
+
+  // headless only: host visible copy of the draw image
+  AllocatedBuffer _readbackBuffer;
+  VkExtent2D _readbackExtent;
 };
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+// upper bound for the runtime frames in flight setting
+constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 4;
 
 class VulkanEngine {
 public:
@@ -125,12 +238,16 @@ public:
 
   void update_scene();
 
-  MaterialInstance defaultData;
+  MaterialHandle defaultData;
   GLTFMetallic_Roughness metalRoughMaterial;
 
   GPUSceneData sceneData;
 
   VkDescriptorSetLayout _gpuSceneDataDescriptorLayout;
+  // write the scene set from a SceneDescriptorData, into a pool set or
+  // into the frame's descriptor buffer
+  DescriptorUpdateTemplate _sceneDescriptorTemplate;
+  DescriptorBufferTemplate _sceneDescriptorBufferTemplate;
 
   std::vector<std::shared_ptr<MeshAsset>> testMeshes;
 
@@ -157,15 +274,32 @@ public:
 
   VkDescriptorSet _drawImageDescriptors;
   VkDescriptorSetLayout _drawImageDescriptorLayout;
+  // holds the draw image sets. every resize makes a new one and retires the
+  // old one together with the old draw images
+  VkDescriptorPool _drawImageDescriptorPool{VK_NULL_HANDLE};
 
   // draw resources
   AllocatedImage _drawImage;
-  AllocatedImage _depthImage;
-
-  AllocatedImage _whiteImage;
-  AllocatedImage _blackImage;
-  AllocatedImage _greyImage;
-  AllocatedImage _errorCheckerboardImage;
+  // async compute only: frames alternate between the two draw images, so
+  // the background of a frame can run while the previous frame still
+  // renders into the other one
+  AllocatedImage _backDrawImage;
+  VkDescriptorSet _backDrawImageDescriptors;
+  // the depth buffer is a render graph transient, allocated by
+  // _transientAllocator with the draw image's extent
+  VkFormat _depthFormat{VK_FORMAT_D32_SFLOAT};
+
+  ImageHandle _whiteImage;
+  ImageHandle _blackImage;
+  ImageHandle _greyImage;
+  ImageHandle _errorCheckerboardImage;
+
+  // buffers, images and materials shared by handle. the pools own them,
+  // whatever is still in a pool at shutdown is destroyed with it. frame
+  // resources and draw targets stay plain members
+  HandlePool<AllocatedBuffer, BufferTag> _buffers;
+  HandlePool<AllocatedImage, ImageTag> _images;
+  HandlePool<MaterialInstance, MaterialTag> _materials;
 
   VkDescriptorSetLayout _singleImageDescriptorLayout;
 
@@ -174,21 +308,130 @@ public:
 
   VmaAllocator _allocator;
 
+  // per heap budgets and the engine's memory per category
+  MemoryTelemetry _memoryTelemetry;
+
+  // tears down what init created, in reverse
   DeletionQueue _mainDeletionQueue;
+  // resources replaced while frames are in flight, destroyed once the frame
+  // timeline passes them. also the leak report at shutdown
+  RetirementQueue _retirement;
 
-  FrameData _frames[FRAME_OVERLAP];
+  FrameData _frames[MAX_FRAMES_IN_FLIGHT];
+  uint32_t _framesInFlight{2};
+
+  // timeline semaphore signalled with _frameNumber + 1 by every frame submit
+  VkSemaphore _frameTimeline;
 
   FrameData &get_current_frame() {
-    return _frames[_frameNumber % FRAME_OVERLAP];
+    return _frames[_frameNumber % _framesInFlight];
   };
 
+  // blocks until the frame timeline has reached the value
+  void wait_frame_timeline(uint64_t value);
+
+  // drains the frames in flight and switches to a new count, 1 to
+  // MAX_FRAMES_IN_FLIGHT
+  void set_frames_in_flight(uint32_t count);
+
   VkQueue _graphicsQueue;
   uint32_t _graphicsQueueFamily;
 
+  // a compute queue from another family than graphics. when there is one
+  // the background runs on it, overlapped with the previous frame's
+  // graphics work, otherwise it stays inline in the frame
+  VkQueue _computeQueue{VK_NULL_HANDLE};
+  uint32_t _computeQueueFamily{0};
+  bool _asyncCompute{false};
+  bool _computeTimestampsSupported{false};
+  // set before init() to keep everything on the graphics queue
+  bool _asyncComputeAllowed{true};
+  // signalled with _frameNumber + 1 by the frame's compute submit, the
+  // graphics submit of the same frame waits on it
+  VkSemaphore _computeTimeline{VK_NULL_HANDLE};
+
+  // a transfer queue from a family other than graphics, preferring a
+  // dedicated one. falls back to the graphics queue
+  VkQueue _transferQueue{VK_NULL_HANDLE};
+  uint32_t _transferQueueFamily{0};
+  // mesh and texture uploads, acquired by the frames once they finish
+  UploadQueue _uploads;
+  // vertices and indices of every mesh
+  GeometryPool _geometry;
+  // the parameters of every material, indexed by the draws
+  MaterialTable _materialTable;
+  // every pooled image and material sampler, bound once per command buffer
+  BindlessHeap _bindless;
+  // the geometry pass takes its sets from descriptor buffers instead of
+  // pools when VK_EXT_descriptor_buffer is there. set
+  // _descriptorBuffersAllowed before init() to keep the pools
+  DescriptorBufferDevice _descriptorBufferDevice;
+  bool _descriptorBuffers{false};
+  bool _descriptorBuffersAllowed{true};
+  // moves pooled images out of sparsely used memory blocks
+  Defragmenter _defragmenter;
+  // frames between fragmentation checks, and the share of a device local
+  // heap's block memory that has to be unused to start a defragmentation
+  int _defragCheckInterval{600};
+  float _defragUnusedRatio{0.25f};
+
   bool _isInitialized{false};
   int _frameNumber{0};
   bool stop_rendering{false};
   bool bUseValidationLayers{true};
+
+  // headless mode renders into _drawImage without a window or swapchain, so
+  // the engine can run on CI machines and software drivers like lavapipe
+  bool _headless{false};
+  // copy every headless frame into a host visible buffer
+  bool _headlessReadback{false};
+
+  // nanoseconds per timestamp tick
+  float _timestampPeriod{1.f};
+  // the graphics queue family has timestamps. without them the frame slots
+  // get no timestamp pool and gpu pass timing stays empty
+  bool _timestampsSupported{false};
+  // covers uniform and storage buffer offset alignment
+  VkDeviceSize _bufferOffsetAlignment{256};
+  // buffers create_buffer made so far
+  std::atomic<uint64_t> _bufferAllocations{0};
+  // gpu time per pass, collected as frames retire
+  GpuPassStats _gpuPassStats;
+
+  FrameStats _frameStats;
+  // passes of the current frame, rebuilt by every draw()
+  RenderGraph _renderGraph;
+  // memory of the graph's transient resources, aliased between resources
+  // whose passes don't overlap
+  TransientAllocator _transientAllocator;
+  // optional device features the statistics queries need. inherited queries
+  // let the geometry query stay active around secondary command buffers
+  bool _pipelineStatisticsSupported{false};
+  bool _inheritedQueriesSupported{false};
+  // time the last draw() spent blocked on the gpu, in ms
+  double _lastFrameWaitMs{0};
+  // cpu time the last draw_geometry() spent recording draws, in ms
+  double _lastGeometryRecordMs{0};
+
+  // threads recording draw_geometry, main thread included. frames with few
+  // draws use fewer threads, see _minDrawsPerRecordThread
+  uint32_t _recordThreads{1};
+  uint32_t _minDrawsPerRecordThread{256};
+
+  // 1 to the job system's thread count, at most MAX_RECORD_THREADS
+  void set_record_threads(uint32_t count);
+
+  // copies of the test scene laid out on a grid, to stress draw recording
+  uint32_t _sceneCopies{1};
+  // give the scene uniforms a vma buffer of their own every frame, like
+  // before the frame slots had linear allocators. for benchmark
+  // comparisons only
+  bool _perFrameUniformBuffers{false};
+  // draw lists of the scene copies traversed by each update_scene job
+  std::vector<DrawContext> _sceneBatchContexts;
+
+  // shared by every subsystem that wants to spread work over the cores
+  JobSystem _jobs;
   // VkExtent2D _windowExtent{800, 600};
   VkExtent2D _drawExtent{800, 600};
   float renderScale = 1.f;
@@ -202,6 +445,13 @@ public:
   VkSwapchainKHR _swapchain;
   VkFormat _swapchainImageFormat;
 
+  // requested presentation policy and the mode it resolved to
+  PresentPolicy _presentPolicy{PresentPolicy::Fifo};
+  VkPresentModeKHR _presentMode{VK_PRESENT_MODE_FIFO_KHR};
+
+  FrameLimiter _frameLimiter;
+  PresentStats _presentStats;
+
   std::vector<VkImage> _swapchainImages;
   std::vector<VkImageView> _swapchainImageViews;
   VkExtent2D _swapchainExtent;
@@ -221,34 +471,110 @@ public:
   // draw loop
   void draw();
 
+  // applies the frame limiter before the next frame samples its input
+  void pace_frame();
+
   // draw background
-  void draw_background(VkCommandBuffer cmd);
+  void draw_background(VkCommandBuffer cmd, GpuTimestampQueries &timestamps,
+                       GpuStatisticsQueries &statistics);
+  // records the background into _drawImage and submits it to the compute
+  // queue, signalling timelineValue on _computeTimeline
+  void submit_async_background(uint64_t timelineValue);
 
   // draw imgui
   void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
 
   // draw geometry
-  void draw_geometry(VkCommandBuffer cmd);
+  void draw_geometry(VkCommandBuffer cmd, VkImageView depthView);
+
+  // records a range of draws, either inline or into a secondary buffer
+  void record_geometry(VkCommandBuffer cmd,
+                       const SceneDescriptor &globalDescriptor,
+                       std::span<const RenderObject> draws,
+                       DrawCounters &counters);
 
   // run main loop
   void run();
 
+  // draw a fixed number of frames and print cpu/gpu frame time percentiles
+  void run_benchmark(uint32_t frameCount);
+
+  // runs the benchmark once per geometry recording thread count
+  void run_recording_benchmark(uint32_t frameCount);
+
+  // times allocating and writing sets from descriptor pools against
+  // descriptor buffers, cpu side only
+  void run_descriptor_benchmark(uint32_t frameCount, uint32_t setsPerFrame);
+
+  // write the last read back headless frame as a binary ppm
+  bool write_readback_ppm(const char *path);
+
+  // returns right away, the buffers can be drawn once
+  // _uploads.is_ready(upload)
   GPUMeshBuffers uploadMesh(std::span<uint32_t> indices,
                             std::span<Vertex> vertices);
+  // gives the mesh's geometry pool range back once the frames in flight
+  // are done with it
+  void destroy_mesh(const GPUMeshBuffers &mesh);
 
-  void create_swapchain(uint32_t width, uint32_t height);
+  void create_swapchain(uint32_t width, uint32_t height,
+                        VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
   void destroy_swapchain();
+  // the memory counts toward category in _memoryTelemetry
   AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage,
-                                VmaMemoryUsage memoryUsage);
+                                VmaMemoryUsage memoryUsage,
+                                MemoryCategory category);
   void destroy_buffer(const AllocatedBuffer &buffer);
   void resize_swapchain();
-  AllocatedImage create_image(VkExtent3D size, VkFormat format,
-                              VkImageUsageFlags usage, bool mipmapped = false);
+
+  // (re)creates the draw images at the given size
+  void create_draw_targets(VkExtent2D extent);
+  AllocatedImage create_draw_image(VkExtent3D extent);
+  // reallocates the draw targets if they can't fit the extent or waste memory
+  void resize_draw_targets(VkExtent2D requiredExtent);
+  void write_draw_image_descriptors();
+  AllocatedImage
+  create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+               bool mipmapped = false,
+               MemoryCategory category = MemoryCategory::Textures);
+  // the contents are uploaded in the background, the image can be sampled
+  // once _uploads.is_ready(image.upload)
   AllocatedImage create_image(void *data, VkExtent3D size, VkFormat format,
                               VkImageUsageFlags usage, bool mipmapped = false);
   void destroy_image(const AllocatedImage &img);
 
+  // hand a buffer or image to its pool. destroying or retiring the handle
+  // destroys the resource
+  BufferHandle add_buffer(const AllocatedBuffer &buffer) {
+    return _buffers.add(buffer);
+  }
+  ImageHandle add_image(const AllocatedImage &image);
+  void destroy_buffer(BufferHandle buffer);
+  void destroy_image(ImageHandle image);
+  // once the frames in flight are done with it
+  void retire_image(ImageHandle image);
+  // everything still in the pools
+  void destroy_pooled_resources();
+
 private:
+  void read_frame_timestamps(FrameData &frame);
+  // fills in the allocation counters of _frameStats before the frame is
+  // submitted
+  void count_frame_allocations(uint64_t bufferAllocationsAtStart);
+  void print_memory_telemetry();
+  // summed over the frame slots
+  DescriptorAllocatorGrowable::Stats frame_descriptor_stats();
+
+  // starts a defragmentation when a device local heap has too much unused
+  // block memory
+  void check_fragmentation();
+  // replaces the pooled resource a defragmentation move belongs to
+  VmaDefragmentationMoveOperation
+  move_allocation(const VmaDefragmentationMove &move, VkCommandBuffer cmd);
+  VmaDefragmentationMoveOperation move_image(ImageHandle handle,
+                                             VmaAllocation destination,
+                                             VkCommandBuffer cmd);
+
   void init_vulkan();
   void init_swapchain();
   void init_commands();
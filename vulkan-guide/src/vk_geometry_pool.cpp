@@ -0,0 +1,179 @@
+#include <vk_geometry_pool.h>
+
+#include <algorithm>
+
+void GeometryPool::init(VkDevice device, VmaAllocator allocator,
+                        std::span<const uint32_t> queueFamilies,
+                        uint32_t blockVertices, uint32_t blockIndices,
+                        MemoryTelemetry *telemetry) {
+  _device = device;
+  _allocator = allocator;
+  _telemetry = telemetry;
+  _blockVertices = blockVertices;
+  _blockIndices = blockIndices;
+
+  // a family listed twice would make the concurrent sharing invalid
+  for (uint32_t family : queueFamilies) {
+    if (std::find(_queueFamilies.begin(), _queueFamilies.end(), family) ==
+        _queueFamilies.end()) {
+      _queueFamilies.push_back(family);
+    }
+  }
+}
+
+void GeometryPool::cleanup() {
+  for (Block &block : _blocks) {
+    if (block.live()) {
+      release_block(block);
+    }
+  }
+  _blocks.clear();
+  _ranges = 0;
+  _retired.clear();
+}
+
+GeometryRange GeometryPool::allocate(uint32_t vertexCount,
+                                     uint32_t indexCount) {
+  GeometryRange range;
+  range.vertexCount = vertexCount;
+  range.indexCount = indexCount;
+
+  for (uint32_t b = 0; b < _blocks.size(); b++) {
+    Block &block = _blocks[b];
+    if (!block.live()) {
+      continue;
+    }
+    if (!block.vertices.allocate(vertexCount, range.vertexOffset)) {
+      continue;
+    }
+    if (!block.indices.allocate(indexCount, range.firstIndex)) {
+      block.vertices.free(range.vertexOffset, vertexCount);
+      continue;
+    }
+
+    range.block = b;
+    _ranges++;
+    return range;
+  }
+
+  range.block = create_block(std::max(vertexCount, _blockVertices),
+                             std::max(indexCount, _blockIndices));
+
+  Block &block = _blocks[range.block];
+  block.vertices.allocate(vertexCount, range.vertexOffset);
+  block.indices.allocate(indexCount, range.firstIndex);
+  _ranges++;
+  return range;
+}
+
+void GeometryPool::free(const GeometryRange &range) {
+  Block &block = _blocks[range.block];
+  block.vertices.free(range.vertexOffset, range.vertexCount);
+  block.indices.free(range.firstIndex, range.indexCount);
+  _ranges--;
+
+  if (block.vertices.used() == 0 && block.indices.used() == 0) {
+    release_block(block);
+  }
+}
+
+void GeometryPool::retire(const GeometryRange &range, uint64_t value) {
+  _retired.push_back({range, value});
+}
+
+void GeometryPool::collect(uint64_t completedValue) {
+  size_t count = 0;
+  while (count < _retired.size() &&
+         _retired[count].retireValue <= completedValue) {
+    free(_retired[count].range);
+    count++;
+  }
+  _retired.erase(_retired.begin(), _retired.begin() + count);
+}
+
+GeometryPool::Stats GeometryPool::stats() const {
+  Stats stats;
+  stats.ranges = _ranges;
+  stats.blocksCreated = _blocksCreated;
+  stats.blocksReleased = _blocksReleased;
+  for (const Block &block : _blocks) {
+    if (!block.live()) {
+      continue;
+    }
+    stats.blocks++;
+    stats.usedBytes += VkDeviceSize(block.vertices.used()) * sizeof(Vertex) +
+                       VkDeviceSize(block.indices.used()) * sizeof(uint32_t);
+    stats.capacityBytes +=
+        VkDeviceSize(block.vertices.capacity()) * sizeof(Vertex) +
+        VkDeviceSize(block.indices.capacity()) * sizeof(uint32_t);
+  }
+  return stats;
+}
+
+uint32_t GeometryPool::create_block(uint32_t vertexCapacity,
+                                    uint32_t indexCapacity) {
+  Block block;
+  block.vertexBuffer =
+      create_buffer(VkDeviceSize(vertexCapacity) * sizeof(Vertex),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  block.indexBuffer =
+      create_buffer(VkDeviceSize(indexCapacity) * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  VkBufferDeviceAddressInfo deviceAdressInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = block.vertexBuffer.buffer};
+  block.vertexAddress = vkGetBufferDeviceAddress(_device, &deviceAdressInfo);
+
+  block.vertices.init(vertexCapacity);
+  block.indices.init(indexCapacity);
+
+  _blocksCreated++;
+
+  for (uint32_t b = 0; b < _blocks.size(); b++) {
+    if (!_blocks[b].live()) {
+      _blocks[b] = std::move(block);
+      return b;
+    }
+  }
+  _blocks.push_back(std::move(block));
+  return static_cast<uint32_t>(_blocks.size() - 1);
+}
+
+void GeometryPool::release_block(Block &block) {
+  vmaDestroyBuffer(_allocator, block.vertexBuffer.buffer,
+                   block.vertexBuffer.allocation);
+  vmaDestroyBuffer(_allocator, block.indexBuffer.buffer,
+                   block.indexBuffer.allocation);
+  _telemetry->remove(MemoryCategory::Meshes,
+                     block.vertexBuffer.info.size +
+                         block.indexBuffer.info.size);
+  block = Block{};
+  _blocksReleased++;
+}
+
+AllocatedBuffer GeometryPool::create_buffer(VkDeviceSize size,
+                                            VkBufferUsageFlags usage) {
+  VkBufferCreateInfo bufferInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  if (_queueFamilies.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount =
+        static_cast<uint32_t>(_queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = _queueFamilies.data();
+  }
+
+  VmaAllocationCreateInfo vmaallocInfo = {};
+  vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  AllocatedBuffer buffer;
+  VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+                           &buffer.buffer, &buffer.allocation, &buffer.info));
+  _telemetry->add(MemoryCategory::Meshes, buffer.info.size);
+  return buffer;
+}
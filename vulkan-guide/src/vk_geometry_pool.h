@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vk_memory_telemetry.h>
+#include <vk_range_allocator.h>
+#include <vk_types.h>
+
+// vertices and indices of every mesh, suballocated from a few large device
+// local buffers. a block pairs a vertex buffer, read through its device
+// address, with an index buffer. draws from the same block share the index
+// buffer binding and the vertex address, and tell meshes apart by
+// firstIndex and vertexOffset. allocation is main thread only, the
+// accessors may be called while recording on any thread
+class GeometryPool {
+public:
+  // the buffers are shared by the queue families, so uploads to one range
+  // don't need ownership transfers of the whole buffer
+  void init(VkDevice device, VmaAllocator allocator,
+            std::span<const uint32_t> queueFamilies, uint32_t blockVertices,
+            uint32_t blockIndices, MemoryTelemetry *telemetry);
+  void cleanup();
+
+  // opens a new block when no existing one has room. meshes larger than a
+  // block get a block of their own size
+  GeometryRange allocate(uint32_t vertexCount, uint32_t indexCount);
+  // the gpu has to be done with the range. a block whose last range is
+  // freed gives its buffers back
+  void free(const GeometryRange &range);
+  // frees the range once collect() sees the frame timeline reach value
+  void retire(const GeometryRange &range, uint64_t value);
+  void collect(uint64_t completedValue);
+
+  VkBuffer vertex_buffer(uint32_t block) const {
+    return _blocks[block].vertexBuffer.buffer;
+  }
+  VkDeviceAddress vertex_address(uint32_t block) const {
+    return _blocks[block].vertexAddress;
+  }
+  VkBuffer index_buffer(uint32_t block) const {
+    return _blocks[block].indexBuffer.buffer;
+  }
+
+  struct Stats {
+    uint32_t blocks{0};
+    uint32_t ranges{0};
+    VkDeviceSize usedBytes{0};
+    VkDeviceSize capacityBytes{0};
+    // since init
+    uint64_t blocksCreated{0};
+    uint64_t blocksReleased{0};
+  };
+  Stats stats() const;
+
+private:
+  // a released block keeps its slot with null buffers, so the block index
+  // of every live range stays valid. create_block reuses the slot
+  struct Block {
+    AllocatedBuffer vertexBuffer{};
+    AllocatedBuffer indexBuffer{};
+    VkDeviceAddress vertexAddress{0};
+    RangeAllocator vertices;
+    RangeAllocator indices;
+
+    bool live() const { return vertexBuffer.buffer != VK_NULL_HANDLE; }
+  };
+
+  // returns the block's index
+  uint32_t create_block(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void release_block(Block &block);
+  AllocatedBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  MemoryTelemetry *_telemetry{nullptr};
+  std::vector<uint32_t> _queueFamilies;
+  uint32_t _blockVertices{0};
+  uint32_t _blockIndices{0};
+
+  std::vector<Block> _blocks;
+  uint32_t _ranges{0};
+  uint64_t _blocksCreated{0};
+  uint64_t _blocksReleased{0};
+
+  struct RetiredRange {
+    GeometryRange range;
+    uint64_t retireValue;
+  };
+  // in retire order, retireValue never decreases
+  std::vector<RetiredRange> _retired;
+};
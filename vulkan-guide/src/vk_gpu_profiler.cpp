@@ -0,0 +1,184 @@
+#include <vk_gpu_profiler.h>
+
+#include <fstream>
+
+#include <fmt/core.h>
+
+const char *gpu_pass_name(GpuPass pass) {
+  switch (pass) {
+  case GpuPass::Frame:
+    return "frame";
+  case GpuPass::Background:
+    return "background";
+  case GpuPass::Geometry:
+    return "geometry";
+  case GpuPass::Blit:
+    return "blit";
+  case GpuPass::Imgui:
+    return "imgui";
+  case GpuPass::Readback:
+    return "readback";
+  case GpuPass::Count:
+    break;
+  }
+  return "unknown";
+}
+
+void GpuTimestampQueries::begin_frame(VkCommandBuffer cmd) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdResetQueryPool(cmd, pool, 0, GPU_TIMESTAMP_COUNT);
+  writtenPasses = 0;
+}
+
+void GpuTimestampQueries::begin_pass(VkCommandBuffer cmd, GpuPass pass) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  uint32_t index = static_cast<uint32_t>(pass);
+  // all commands, so the pass starts once the work before it has finished
+  // instead of overlapping with it
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, pool,
+                       index * 2);
+}
+
+void GpuTimestampQueries::end_pass(VkCommandBuffer cmd, GpuPass pass) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  uint32_t index = static_cast<uint32_t>(pass);
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, pool,
+                       index * 2 + 1);
+  writtenPasses |= 1u << index;
+}
+
+void GpuStatisticsQueries::begin_frame(VkCommandBuffer cmd) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdResetQueryPool(cmd, pool, 0, GPU_PASS_COUNT);
+  writtenPasses = 0;
+}
+
+void GpuStatisticsQueries::begin_pass(VkCommandBuffer cmd, GpuPass pass) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdBeginQuery(cmd, pool, static_cast<uint32_t>(pass), 0);
+}
+
+void GpuStatisticsQueries::end_pass(VkCommandBuffer cmd, GpuPass pass) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  uint32_t index = static_cast<uint32_t>(pass);
+  vkCmdEndQuery(cmd, pool, index);
+  writtenPasses |= 1u << index;
+}
+
+bool GpuStatisticsQueries::read(VkDevice device,
+                                PipelineStatistics &outStatistics) {
+  if (pool == VK_NULL_HANDLE || writtenPasses == 0) {
+    return false;
+  }
+
+  // the counters of every query followed by its availability
+  constexpr uint32_t stride = PIPELINE_STATISTIC_COUNT + 1;
+  uint64_t results[GPU_PASS_COUNT * stride];
+  VkResult result = vkGetQueryPoolResults(
+      device, pool, 0, GPU_PASS_COUNT, sizeof(results), results,
+      sizeof(uint64_t) * stride,
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    return false;
+  }
+
+  PipelineStatistics sum;
+  bool available = false;
+  for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++) {
+    const uint64_t *counters = &results[pass * stride];
+    if (!(writtenPasses & (1u << pass)) ||
+        counters[PIPELINE_STATISTIC_COUNT] == 0) {
+      continue;
+    }
+
+    available = true;
+    sum.inputPrimitives += counters[0];
+    sum.vertexInvocations += counters[1];
+    sum.clippingInvocations += counters[2];
+    sum.clippingPrimitives += counters[3];
+    sum.fragmentInvocations += counters[4];
+    sum.computeInvocations += counters[5];
+  }
+
+  writtenPasses = 0;
+  if (available) {
+    outStatistics = sum;
+  }
+  return available;
+}
+
+void GpuPassStats::read_frame(VkDevice device, GpuTimestampQueries &queries,
+                              float timestampPeriod) {
+  if (queries.writtenPasses == 0) {
+    return;
+  }
+
+  // value and availability for every query. unwritten queries stay
+  // unavailable, so the call returns VK_NOT_READY without waiting
+  uint64_t results[GPU_TIMESTAMP_COUNT * 2];
+  VkResult result = vkGetQueryPoolResults(
+      device, queries.pool, 0, GPU_TIMESTAMP_COUNT, sizeof(results), results,
+      sizeof(uint64_t) * 2,
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    return;
+  }
+
+  for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++) {
+    if (!(queries.writtenPasses & (1u << pass))) {
+      continue;
+    }
+
+    const uint64_t *begin = &results[pass * 4];
+    const uint64_t *end = &results[pass * 4 + 2];
+    if (begin[1] == 0 || end[1] == 0) {
+      continue;
+    }
+
+    double ms = double(end[0] - begin[0]) * timestampPeriod / 1000000.0;
+    rolling[pass].push(ms);
+    if (recording) {
+      recorded[pass].push_back(ms);
+    }
+  }
+
+  queries.writtenPasses = 0;
+}
+
+void GpuPassStats::start_recording() {
+  for (std::vector<double> &samples : recorded) {
+    samples.clear();
+  }
+  recording = true;
+}
+
+bool GpuPassStats::write_csv(const char *path) const {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file << "pass,count,mean_ms,p50_ms,p90_ms,p95_ms,p99_ms,min_ms,max_ms\n";
+  for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++) {
+    SampleSummary summary = rolling[pass].summary();
+    file << fmt::format("{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},"
+                        "{:.4f}\n",
+                        gpu_pass_name(static_cast<GpuPass>(pass)),
+                        summary.count, summary.mean, summary.p50, summary.p90,
+                        summary.p95, summary.p99, summary.min, summary.max);
+  }
+
+  return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vk_stats.h>
+#include <vk_types.h>
+
+// parts of the frame bracketed with timestamp queries. Frame spans the whole
+// command buffer
+enum class GpuPass : uint8_t {
+  Frame,
+  Background,
+  Geometry,
+  // copy of the draw image into the swapchain
+  Blit,
+  Imgui,
+  // headless copy of the draw image into the readback buffer
+  Readback,
+  Count
+};
+
+constexpr uint32_t GPU_PASS_COUNT = static_cast<uint32_t>(GpuPass::Count);
+// a begin and an end query per pass
+constexpr uint32_t GPU_TIMESTAMP_COUNT = GPU_PASS_COUNT * 2;
+
+const char *gpu_pass_name(GpuPass pass);
+
+// the timestamp queries of one frame slot. without a pool, on queues that
+// don't support timestamps, nothing gets written
+struct GpuTimestampQueries {
+  VkQueryPool pool{VK_NULL_HANDLE};
+  // bit per pass that was bracketed in the last recorded frame
+  uint32_t writtenPasses{0};
+
+  // resets the queries, has to be recorded before any pass
+  void begin_frame(VkCommandBuffer cmd);
+  void begin_pass(VkCommandBuffer cmd, GpuPass pass);
+  void end_pass(VkCommandBuffer cmd, GpuPass pass);
+};
+
+// brackets the commands recorded during its lifetime
+class GpuPassScope {
+public:
+  GpuPassScope(VkCommandBuffer cmd, GpuTimestampQueries &queries,
+               GpuPass pass)
+      : _cmd(cmd), _queries(queries), _pass(pass) {
+    _queries.begin_pass(_cmd, _pass);
+  }
+  ~GpuPassScope() { _queries.end_pass(_cmd, _pass); }
+
+  GpuPassScope(const GpuPassScope &) = delete;
+  GpuPassScope &operator=(const GpuPassScope &) = delete;
+
+private:
+  VkCommandBuffer _cmd;
+  GpuTimestampQueries &_queries;
+  GpuPass _pass;
+};
+
+// pipeline statistics of the passes bracketed in a frame, summed up
+struct PipelineStatistics {
+  uint64_t inputPrimitives{0};
+  uint64_t vertexInvocations{0};
+  uint64_t clippingInvocations{0};
+  uint64_t clippingPrimitives{0};
+  uint64_t fragmentInvocations{0};
+  uint64_t computeInvocations{0};
+};
+
+// the counters above. vulkan writes results in flag bit order, which is
+// also the order of the struct
+constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+constexpr uint32_t PIPELINE_STATISTIC_COUNT = 6;
+
+// pipeline statistics queries of one frame slot, one query per pass. the
+// pool only exists when the device supports pipelineStatisticsQuery
+struct GpuStatisticsQueries {
+  VkQueryPool pool{VK_NULL_HANDLE};
+  uint32_t writtenPasses{0};
+
+  void begin_frame(VkCommandBuffer cmd);
+  // can't be nested, and the pass has to begin and end outside or inside
+  // the same rendering
+  void begin_pass(VkCommandBuffer cmd, GpuPass pass);
+  void end_pass(VkCommandBuffer cmd, GpuPass pass);
+
+  // sums the passes of a finished frame without waiting. false if nothing
+  // was written or the results aren't available
+  bool read(VkDevice device, PipelineStatistics &outStatistics);
+};
+
+// gpu time per pass, in ms
+struct GpuPassStats {
+  RollingSamples rolling[GPU_PASS_COUNT];
+
+  // every sample since start_recording, for benchmarks
+  std::vector<double> recorded[GPU_PASS_COUNT];
+  bool recording{false};
+
+  // collects the results of a frame the gpu has finished. does not wait,
+  // passes whose results aren't available are skipped
+  void read_frame(VkDevice device, GpuTimestampQueries &queries,
+                  float timestampPeriod);
+
+  void start_recording();
+
+  SampleSummary rolling_summary(GpuPass pass) const {
+    return rolling[static_cast<uint32_t>(pass)].summary();
+  }
+  double rolling_mean(GpuPass pass) const {
+    return rolling[static_cast<uint32_t>(pass)].mean();
+  }
+
+  // one line per pass with the rolling window's statistics
+  bool write_csv(const char *path) const;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cassert>
+
+#include <vk_types.h>
+
+// a 32 bit reference into a HandlePool: the slot index in the low bits and
+// the slot's generation in the high bits. a slot's generation changes every
+// time it is freed, so stale handles are caught instead of reading whatever
+// took the slot over. 0 is never handed out and stands for no resource. the
+// tag keeps handles of different pools apart
+template <typename Tag> struct Handle {
+  static constexpr uint32_t IndexBits = 20;
+  static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+
+  uint32_t value{0};
+
+  uint32_t index() const { return value & IndexMask; }
+  uint32_t generation() const { return value >> IndexBits; }
+  bool is_null() const { return value == 0; }
+
+  bool operator==(const Handle &other) const = default;
+};
+
+// owns values of T in one contiguous array and hands out generational
+// handles to them. lookups are an index, no refcounts or hashing. freed
+// slots are reused, newest first. handles are validated by assert, so
+// release builds pay nothing for them. not thread safe, but get() may be
+// called from several threads while nothing is added or removed
+template <typename T, typename Tag> class HandlePool {
+public:
+  using HandleType = Handle<Tag>;
+
+  HandleType add(const T &value) {
+    uint32_t index;
+    if (_free.empty()) {
+      index = static_cast<uint32_t>(_items.size());
+      assert(index <= HandleType::IndexMask);
+      _items.push_back(value);
+      // generation 0 would make the first handle of slot 0 null
+      _generations.push_back(1);
+    } else {
+      index = _free.back();
+      _free.pop_back();
+      _items[index] = value;
+    }
+    _count++;
+    return {(_generations[index] << HandleType::IndexBits) | index};
+  }
+
+  // returns the value, the handle is stale afterwards
+  T remove(HandleType handle) {
+    assert(valid(handle));
+    uint32_t index = handle.index();
+    T value = std::move(_items[index]);
+    _items[index] = {};
+
+    // skip 0 on wrap around, so no handle becomes null
+    uint32_t generationMask = ~0u >> HandleType::IndexBits;
+    uint32_t generation = (_generations[index] + 1) & generationMask;
+    _generations[index] = generation == 0 ? 1 : generation;
+
+    _free.push_back(index);
+    _count--;
+    return value;
+  }
+
+  bool valid(HandleType handle) const {
+    return !handle.is_null() && handle.index() < _items.size() &&
+           _generations[handle.index()] == handle.generation();
+  }
+
+  T &get(HandleType handle) {
+    assert(valid(handle));
+    return _items[handle.index()];
+  }
+  const T &get(HandleType handle) const {
+    assert(valid(handle));
+    return _items[handle.index()];
+  }
+
+  // live values
+  size_t size() const { return _count; }
+
+  // calls fn(handle, value) for every live value
+  template <typename F> void for_each(F &&fn) {
+    std::vector<bool> freeSlot(_items.size(), false);
+    for (uint32_t index : _free) {
+      freeSlot[index] = true;
+    }
+    for (uint32_t i = 0; i < _items.size(); i++) {
+      if (!freeSlot[i]) {
+        fn(HandleType{(_generations[i] << HandleType::IndexBits) | i},
+           _items[i]);
+      }
+    }
+  }
+
+private:
+  std::vector<T> _items;
+  std::vector<uint32_t> _generations;
+  std::vector<uint32_t> _free;
+  size_t _count{0};
+};
+
+struct BufferTag;
+struct ImageTag;
+struct MaterialTag;
+using BufferHandle = Handle<BufferTag>;
+using ImageHandle = Handle<ImageTag>;
+using MaterialHandle = Handle<MaterialTag>;
@@ -69,3 +69,21 @@ void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source,
 
   vkCmdBlitImage2(cmd, &blitInfo);
 }
+
+void vkutil::copy_image_to_buffer(VkCommandBuffer cmd, VkImage source,
+                                  VkBuffer destination, VkExtent2D size) {
+  VkBufferImageCopy copyRegion = {};
+  copyRegion.bufferOffset = 0;
+  // tightly packed rows
+  copyRegion.bufferRowLength = 0;
+  copyRegion.bufferImageHeight = 0;
+
+  copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copyRegion.imageSubresource.mipLevel = 0;
+  copyRegion.imageSubresource.baseArrayLayer = 0;
+  copyRegion.imageSubresource.layerCount = 1;
+  copyRegion.imageExtent = {size.width, size.height, 1};
+
+  vkCmdCopyImageToBuffer(cmd, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         destination, 1, &copyRegion);
+}
@@ -10,4 +10,7 @@ void copy_image_to_image(VkCommandBuffer cmd, VkImage source,
                          VkImage destination, VkExtent2D srcSize,
                          VkExtent2D dstSize);
 
+void copy_image_to_buffer(VkCommandBuffer cmd, VkImage source,
+                          VkBuffer destination, VkExtent2D size);
+
 }; // namespace vkutil
@@ -14,7 +14,8 @@ VkCommandPoolCreateInfo vkinit::command_pool_create_info(uint32_t queueFamilyInd
 
 
 VkCommandBufferAllocateInfo vkinit::command_buffer_allocate_info(
-    VkCommandPool pool, uint32_t count /*= 1*/)
+    VkCommandPool pool, uint32_t count /*= 1*/,
+    VkCommandBufferLevel level /*= VK_COMMAND_BUFFER_LEVEL_PRIMARY*/)
 {
     VkCommandBufferAllocateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -22,7 +23,7 @@ VkCommandBufferAllocateInfo vkinit::command_buffer_allocate_info(
 
     info.commandPool = pool;
     info.commandBufferCount = count;
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.level = level;
     return info;
 }
 //< init_cmd
@@ -60,10 +61,21 @@ VkSemaphoreCreateInfo vkinit::semaphore_create_info(VkSemaphoreCreateFlags flags
     info.flags = flags;
     return info;
 }
+
+VkSemaphoreTypeCreateInfo vkinit::semaphore_type_create_info(VkSemaphoreType type, uint64_t initialValue /*= 0*/)
+{
+    VkSemaphoreTypeCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.semaphoreType = type;
+    info.initialValue = initialValue;
+    return info;
+}
 //< init_sync
 
 //> init_submit
-VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore)
+VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore,
+    uint64_t value /*= 1*/)
 {
 	VkSemaphoreSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
@@ -71,7 +83,8 @@ VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageM
 	submitInfo.semaphore = semaphore;
 	submitInfo.stageMask = stageMask;
 	submitInfo.deviceIndex = 0;
-	submitInfo.value = 1;
+	// ignored for binary semaphores
+	submitInfo.value = value;
 
 	return submitInfo;
 }
@@ -334,4 +347,15 @@ VkPipelineShaderStageCreateInfo vkinit::pipeline_shader_stage_create_info(VkShad
     // the entry point of the shader
     info.pName = entry;
     return info;
-}
\ No newline at end of file
+}
+
+VkQueryPoolCreateInfo vkinit::query_pool_create_info(VkQueryType type, uint32_t queryCount)
+{
+    VkQueryPoolCreateInfo info {};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.pNext = nullptr;
+
+    info.queryType = type;
+    info.queryCount = queryCount;
+    return info;
+}
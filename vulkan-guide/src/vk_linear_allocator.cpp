@@ -0,0 +1,68 @@
+#include <vk_linear_allocator.h>
+
+#include <algorithm>
+
+void LinearAllocator::init(VmaAllocator allocator, VkDeviceSize blockSize,
+                           VkDeviceSize alignment,
+                           MemoryTelemetry *telemetry) {
+  _allocator = allocator;
+  _blockSize = blockSize;
+  _alignment = alignment;
+  _telemetry = telemetry;
+}
+
+void LinearAllocator::cleanup() {
+  for (Block &block : _blocks) {
+    vmaDestroyBuffer(_allocator, block.buffer.buffer, block.buffer.allocation);
+    _telemetry->remove(MemoryCategory::Uniforms, block.buffer.info.size);
+  }
+  _blocks.clear();
+}
+
+void LinearAllocator::reset() {
+  _currentBlock = 0;
+  _offset = 0;
+  _allocations = 0;
+  _usedBytes = 0;
+}
+
+LinearAllocation LinearAllocator::allocate(VkDeviceSize size) {
+  VkDeviceSize offset = (_offset + _alignment - 1) / _alignment * _alignment;
+
+  // move on to the next block until one has room
+  while (_currentBlock < _blocks.size() &&
+         offset + size > _blocks[_currentBlock].size) {
+    _currentBlock++;
+    offset = 0;
+  }
+
+  if (_currentBlock == _blocks.size()) {
+    Block block;
+    block.size = std::max(_blockSize, size);
+
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = block.size;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VmaAllocationCreateInfo vmaallocInfo = {};
+    vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+                             &block.buffer.buffer, &block.buffer.allocation,
+                             &block.buffer.info));
+
+    _telemetry->add(MemoryCategory::Uniforms, block.buffer.info.size);
+    _blocks.push_back(block);
+  }
+
+  Block &block = _blocks[_currentBlock];
+  _offset = offset + size;
+  _allocations++;
+  _usedBytes += size;
+
+  return {block.buffer.buffer, offset,
+          static_cast<char *>(block.buffer.info.pMappedData) + offset};
+}
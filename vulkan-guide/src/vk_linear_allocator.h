@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstring>
+
+#include <vk_memory_telemetry.h>
+#include <vk_types.h>
+
+// a suballocation of a linear allocator's buffer, written through data
+struct LinearAllocation {
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  void *data;
+};
+
+// bump allocator for data that lives for one frame, like uniforms. the
+// memory is host visible and stays mapped. every frame slot owns one and
+// resets it once the slot's last frame has finished. main thread only
+class LinearAllocator {
+public:
+  // alignment has to cover minUniformBufferOffsetAlignment and
+  // minStorageBufferOffsetAlignment for the buffers the data is bound as
+  void init(VmaAllocator allocator, VkDeviceSize blockSize,
+            VkDeviceSize alignment, MemoryTelemetry *telemetry);
+  void cleanup();
+
+  // the gpu is done with everything allocated so far
+  void reset();
+
+  // never fails, a full block continues in the next one, created the first
+  // time it is needed and kept afterwards
+  LinearAllocation allocate(VkDeviceSize size);
+
+  template <typename T> LinearAllocation push(const T &value) {
+    LinearAllocation allocation = allocate(sizeof(T));
+    memcpy(allocation.data, &value, sizeof(T));
+    return allocation;
+  }
+
+  // since the last reset
+  uint32_t allocations() const { return _allocations; }
+  VkDeviceSize used_bytes() const { return _usedBytes; }
+  size_t block_count() const { return _blocks.size(); }
+
+private:
+  struct Block {
+    AllocatedBuffer buffer;
+    VkDeviceSize size;
+  };
+
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  VkDeviceSize _blockSize{0};
+  VkDeviceSize _alignment{1};
+  MemoryTelemetry *_telemetry{nullptr};
+
+  std::vector<Block> _blocks;
+  size_t _currentBlock{0};
+  VkDeviceSize _offset{0};
+
+  uint32_t _allocations{0};
+  VkDeviceSize _usedBytes{0};
+};
@@ -4,6 +4,7 @@
 
 #include "vk_engine.h"
 #include "vk_initializers.h"
+#include "vk_profiler.h"
 #include "vk_types.h"
 #include <glm/gtx/quaternion.hpp>
 
@@ -13,6 +14,7 @@
 
 std::optional<std::vector<std::shared_ptr<MeshAsset>>>
 loadGltfMeshes(VulkanEngine *engine, std::filesystem::path filePath) {
+  PROFILE_FUNCTION();
   std::cout << "Loading GLTF: " << filePath << std::endl;
 
   fastgltf::GltfDataBuffer data;
@@ -35,18 +37,18 @@ loadGltfMeshes(VulkanEngine *engine, std::filesystem::path filePath) {
 
   std::vector<std::shared_ptr<MeshAsset>> meshes;
 
-  // use the same vectors for all meshes so that the memory doesnt reallocate as
-  // often
-  std::vector<uint32_t> indices;
-  std::vector<Vertex> vertices;
-  for (fastgltf::Mesh &mesh : gltf.meshes) {
-    MeshAsset newmesh;
+  // meshes are converted in parallel, each into its own arrays
+  std::vector<MeshAsset> newMeshes(gltf.meshes.size());
+  std::vector<std::vector<uint32_t>> meshIndices(gltf.meshes.size());
+  std::vector<std::vector<Vertex>> meshVertices(gltf.meshes.size());
 
-    newmesh.name = mesh.name;
+  auto convertMesh = [&](uint32_t meshIndex) {
+    fastgltf::Mesh &mesh = gltf.meshes[meshIndex];
+    MeshAsset &newmesh = newMeshes[meshIndex];
+    std::vector<uint32_t> &indices = meshIndices[meshIndex];
+    std::vector<Vertex> &vertices = meshVertices[meshIndex];
 
-    // clear the mesh arrays each mesh, we dont want to merge them by error
-    indices.clear();
-    vertices.clear();
+    newmesh.name = mesh.name;
 
     for (auto &&p : mesh.primitives) {
       GeoSurface newSurface;
@@ -128,10 +130,26 @@ loadGltfMeshes(VulkanEngine *engine, std::filesystem::path filePath) {
         vtx.color = glm::vec4(vtx.normal, 1.f);
       }
     }
-    newmesh.meshBuffers = engine->uploadMesh(indices, vertices);
-
-    meshes.emplace_back(std::make_shared<MeshAsset>(std::move(newmesh)));
+  };
+
+  engine->_jobs.parallel_for(
+      static_cast<uint32_t>(gltf.meshes.size()), 1,
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          convertMesh(i);
+        }
+      });
+
+  // uploads are recorded into the upload queue's open batch, which only the
+  // main thread may use. the meshes go out in as few submits as the
+  // staging ring allows and finish in the background
+  for (size_t i = 0; i < newMeshes.size(); i++) {
+    newMeshes[i].meshBuffers =
+        engine->uploadMesh(meshIndices[i], meshVertices[i]);
+
+    meshes.emplace_back(std::make_shared<MeshAsset>(std::move(newMeshes[i])));
   }
+  engine->_uploads.flush();
 
   return meshes;
 }
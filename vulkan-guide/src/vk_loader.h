@@ -1,10 +1,12 @@
 ﻿#pragma once
 #include <filesystem>
 #include <unordered_map>
+#include <vk_handle_pool.h>
 #include <vk_types.h>
 
 struct GLTFMaterial {
-  MaterialInstance data;
+  // in the engine's material pool
+  MaterialHandle data;
 };
 
 struct GeoSurface {
@@ -0,0 +1,152 @@
+#include <vk_material_table.h>
+
+#include <algorithm>
+
+// vkCmdUpdateBuffer copies at most this much per call
+static constexpr VkDeviceSize MaxUpdateSize = 65536;
+
+void MaterialTable::init(VkDevice device, VmaAllocator allocator,
+                         uint32_t capacity, RetirementQueue *retirement) {
+  _device = device;
+  _allocator = allocator;
+  _retirement = retirement;
+
+  create_buffer(std::max(capacity, 1u));
+}
+
+void MaterialTable::cleanup() {
+  _retirement->untrack(resource_handle(_buffer.buffer));
+  vmaDestroyBuffer(_allocator, _buffer.buffer, _buffer.allocation);
+  _buffer = {};
+  _records.clear();
+  _free.clear();
+  _dirty.clear();
+  _isDirty.clear();
+}
+
+uint32_t MaterialTable::add(const GPUMaterialData &record) {
+  uint32_t index;
+  if (!_free.empty()) {
+    index = _free.back();
+    _free.pop_back();
+    _records[index] = record;
+  } else {
+    index = static_cast<uint32_t>(_records.size());
+    _records.push_back(record);
+    _isDirty.push_back(false);
+  }
+
+  if (_records.size() > _capacity) {
+    // frames in flight still read the old buffer, the new one gets every
+    // record on the next flush
+    _retirement->retire_buffer(_buffer);
+    create_buffer(_capacity * 2);
+    for (uint32_t i = 0; i < _records.size(); i++) {
+      mark_dirty(i);
+    }
+  } else {
+    mark_dirty(index);
+  }
+  return index;
+}
+
+void MaterialTable::update(uint32_t index, const GPUMaterialData &record) {
+  _records[index] = record;
+  mark_dirty(index);
+}
+
+void MaterialTable::remove(uint32_t index) {
+  // the record isn't drawn with anymore, it doesn't need clearing
+  _free.push_back(index);
+}
+
+void MaterialTable::flush(VkCommandBuffer cmd) {
+  _lastCopies = 0;
+  _lastBytesCopied = 0;
+  if (_dirty.empty()) {
+    return;
+  }
+
+  // after the shader reads of earlier frames
+  VkMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                         VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+  barrier.srcAccessMask = VK_ACCESS_2_NONE;
+  barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  VkDependencyInfo dependency = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  dependency.memoryBarrierCount = 1;
+  dependency.pMemoryBarriers = &barrier;
+  vkCmdPipelineBarrier2(cmd, &dependency);
+
+  // neighbouring dirty records are copied together
+  std::sort(_dirty.begin(), _dirty.end());
+  size_t runStart = 0;
+  for (size_t i = 1; i <= _dirty.size(); i++) {
+    if (i < _dirty.size() && _dirty[i] == _dirty[i - 1] + 1) {
+      continue;
+    }
+
+    VkDeviceSize offset = _dirty[runStart] * sizeof(GPUMaterialData);
+    VkDeviceSize size = (i - runStart) * sizeof(GPUMaterialData);
+    const char *data = (const char *)&_records[_dirty[runStart]];
+    for (VkDeviceSize copied = 0; copied < size; copied += MaxUpdateSize) {
+      VkDeviceSize chunk = std::min(size - copied, MaxUpdateSize);
+      vkCmdUpdateBuffer(cmd, _buffer.buffer, offset + copied, chunk,
+                        data + copied);
+      _lastCopies++;
+    }
+    _lastBytesCopied += size;
+    runStart = i;
+  }
+
+  for (uint32_t index : _dirty) {
+    _isDirty[index] = false;
+  }
+  _dirty.clear();
+
+  barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                         VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+  barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+  vkCmdPipelineBarrier2(cmd, &dependency);
+}
+
+MaterialTable::Stats MaterialTable::stats() const {
+  Stats stats;
+  stats.records = static_cast<uint32_t>(_records.size() - _free.size());
+  stats.capacity = _capacity;
+  stats.copies = _lastCopies;
+  stats.bytesCopied = _lastBytesCopied;
+  return stats;
+}
+
+void MaterialTable::create_buffer(uint32_t capacity) {
+  VkBufferCreateInfo bufferInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bufferInfo.size = capacity * sizeof(GPUMaterialData);
+  // descriptor buffers reference it by address
+  bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+  VmaAllocationCreateInfo vmaallocInfo = {};
+  vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+                           &_buffer.buffer, &_buffer.allocation,
+                           &_buffer.info));
+  _buffer.usage = bufferInfo.usage;
+  _buffer.size = bufferInfo.size;
+  _retirement->track(ResourceType::Buffer, resource_handle(_buffer.buffer),
+                     _buffer.info.size, MemoryCategory::Uniforms);
+  _capacity = capacity;
+}
+
+void MaterialTable::mark_dirty(uint32_t index) {
+  if (!_isDirty[index]) {
+    _isDirty[index] = true;
+    _dirty.push_back(index);
+  }
+}
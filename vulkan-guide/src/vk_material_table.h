@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vk_retirement.h>
+#include <vk_types.h>
+
+// the parameters of every material, packed in one device local storage
+// buffer that the mesh shaders index with the draw's material index.
+// records are written to a cpu side copy and marked dirty, flush() copies
+// the dirty runs into the buffer at the start of the frame. the buffer
+// doubles when it runs out of room, the old one is retired. the buffer's
+// bytes count as Uniforms through the retirement queue's tracking. main
+// thread only
+class MaterialTable {
+public:
+  void init(VkDevice device, VmaAllocator allocator, uint32_t capacity,
+            RetirementQueue *retirement);
+  void cleanup();
+
+  // the index stays valid until the record is removed
+  uint32_t add(const GPUMaterialData &record);
+  void update(uint32_t index, const GPUMaterialData &record);
+  void remove(uint32_t index);
+
+  const GPUMaterialData &get(uint32_t index) const { return _records[index]; }
+
+  // records the copies of the dirty records, and a barrier that makes them
+  // visible to the vertex and fragment shaders. before any draw of the frame
+  void flush(VkCommandBuffer cmd);
+
+  VkBuffer buffer() const { return _buffer.buffer; }
+  VkDeviceSize size() const { return _buffer.size; }
+
+  struct Stats {
+    uint32_t records{0};
+    uint32_t capacity{0};
+    // by the last flush
+    uint32_t copies{0};
+    VkDeviceSize bytesCopied{0};
+  };
+  Stats stats() const;
+
+private:
+  void create_buffer(uint32_t capacity);
+  void mark_dirty(uint32_t index);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  RetirementQueue *_retirement{nullptr};
+
+  AllocatedBuffer _buffer{};
+  uint32_t _capacity{0};
+
+  // indexed by material index, removed records stay as holes until reused
+  std::vector<GPUMaterialData> _records;
+  std::vector<uint32_t> _free;
+
+  // indices written since the last flush, each listed once
+  std::vector<uint32_t> _dirty;
+  std::vector<bool> _isDirty;
+
+  uint32_t _lastCopies{0};
+  VkDeviceSize _lastBytesCopied{0};
+};
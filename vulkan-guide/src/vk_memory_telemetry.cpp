@@ -0,0 +1,100 @@
+#include <vk_memory_telemetry.h>
+
+#include <cstring>
+#include <fstream>
+
+const char *memory_category_name(MemoryCategory category) {
+  switch (category) {
+  case MemoryCategory::Meshes:
+    return "meshes";
+  case MemoryCategory::Textures:
+    return "textures";
+  case MemoryCategory::RenderTargets:
+    return "render targets";
+  case MemoryCategory::Uniforms:
+    return "uniforms";
+  case MemoryCategory::Staging:
+    return "staging";
+  case MemoryCategory::Other:
+    return "other";
+  }
+  return "unknown";
+}
+
+bool MemoryTelemetry::budget_extension_supported(
+    VkPhysicalDevice physicalDevice) {
+  uint32_t count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       extensions.data());
+
+  for (const VkExtensionProperties &extension : extensions) {
+    if (strcmp(extension.extensionName,
+               VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MemoryTelemetry::init(VmaAllocator allocator, bool budgetExtension) {
+  _allocator = allocator;
+  _budgetExtension = budgetExtension;
+
+  const VkPhysicalDeviceMemoryProperties *memoryProperties;
+  vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+  _heaps.resize(memoryProperties->memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+    _heaps[i].heap = i;
+    _heaps[i].deviceLocal = memoryProperties->memoryHeaps[i].flags &
+                            VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  }
+  _overBudget.assign(_heaps.size(), false);
+
+  update(0);
+}
+
+void MemoryTelemetry::update(uint32_t frameIndex) {
+  // the budget is queried from the driver at most once per frame index
+  vmaSetCurrentFrameIndex(_allocator, frameIndex);
+
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+  vmaGetHeapBudgets(_allocator, budgets);
+
+  for (HeapBudget &heap : _heaps) {
+    const VmaBudget &budget = budgets[heap.heap];
+    heap.blockBytes = budget.statistics.blockBytes;
+    heap.allocationBytes = budget.statistics.allocationBytes;
+    heap.usage = budget.usage;
+    heap.budget = budget.budget;
+
+    bool over = heap.usage > VkDeviceSize(_budgetThreshold * heap.budget);
+    if (over && !_overBudget[heap.heap] && _budgetCallback) {
+      _budgetCallback(heap);
+    }
+    _overBudget[heap.heap] = over;
+  }
+}
+
+void MemoryTelemetry::set_budget_callback(float threshold,
+                                          BudgetCallback &&callback) {
+  _budgetThreshold = threshold;
+  _budgetCallback = std::move(callback);
+}
+
+bool MemoryTelemetry::write_json(const char *path) const {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  char *stats = nullptr;
+  vmaBuildStatsString(_allocator, &stats, VK_TRUE);
+  file << stats;
+  vmaFreeStatsString(_allocator, stats);
+
+  return file.good();
+}
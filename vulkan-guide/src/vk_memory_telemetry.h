@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+
+#include <vk_types.h>
+
+// what the engine allocated the memory for
+enum class MemoryCategory : uint8_t {
+  Meshes,
+  Textures,
+  RenderTargets,
+  Uniforms,
+  Staging,
+  Other,
+};
+constexpr size_t MemoryCategoryCount = 6;
+
+const char *memory_category_name(MemoryCategory category);
+
+// a memory heap, as VMA sees it. with VK_EXT_memory_budget usage and
+// budget come from the driver and include other processes, without it
+// they are VMA's own estimate
+struct HeapBudget {
+  uint32_t heap;
+  bool deviceLocal;
+  // memory VMA has allocated in blocks, and handed out of them
+  VkDeviceSize blockBytes;
+  VkDeviceSize allocationBytes;
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+};
+
+// per heap usage and budget, polled once a frame, and the engine's own
+// bytes per category. categories are counted by whoever creates the memory
+// and may be updated from any thread
+class MemoryTelemetry {
+public:
+  // true if the device can report budgets through VK_EXT_memory_budget
+  static bool budget_extension_supported(VkPhysicalDevice physicalDevice);
+
+  void init(VmaAllocator allocator, bool budgetExtension);
+
+  // reads the heap budgets and calls the budget callback for every heap
+  // that went over its threshold since the last update
+  void update(uint32_t frameIndex);
+
+  std::span<const HeapBudget> heaps() const { return _heaps; }
+  bool budget_extension() const { return _budgetExtension; }
+
+  void add(MemoryCategory category, VkDeviceSize bytes) {
+    _categoryBytes[static_cast<size_t>(category)] += bytes;
+  }
+  void remove(MemoryCategory category, VkDeviceSize bytes) {
+    _categoryBytes[static_cast<size_t>(category)] -= bytes;
+  }
+  VkDeviceSize bytes(MemoryCategory category) const {
+    return _categoryBytes[static_cast<size_t>(category)];
+  }
+
+  // called once when a heap's usage goes over threshold * budget, and again
+  // only after it went back below. meant for streaming, to drop or delay
+  // resources before the driver starts evicting
+  using BudgetCallback = std::function<void(const HeapBudget &heap)>;
+  void set_budget_callback(float threshold, BudgetCallback &&callback);
+
+  // the allocator's detailed statistics as VMA's json
+  bool write_json(const char *path) const;
+
+private:
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  bool _budgetExtension{false};
+  std::vector<HeapBudget> _heaps;
+
+  std::array<std::atomic<VkDeviceSize>, MemoryCategoryCount> _categoryBytes{};
+
+  float _budgetThreshold{0.9f};
+  BudgetCallback _budgetCallback;
+  // heaps over the threshold at the last update
+  std::vector<bool> _overBudget;
+};
@@ -70,6 +70,8 @@ void PipelineBuilder::clear() {
   _renderInfo = {.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
 
   _shaderStages.clear();
+
+  _flags = 0;
 }
 
 VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
@@ -116,6 +118,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDepthStencilState = &_depthStencil;
   pipelineInfo.layout = _pipelineLayout;
+  pipelineInfo.flags = _flags;
 
   VkDynamicState state[] = {VK_DYNAMIC_STATE_VIEWPORT,
                             VK_DYNAMIC_STATE_SCISSOR};
@@ -249,3 +252,7 @@ void PipelineBuilder::enable_blending_alphablend() {
   _colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
   _colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 }
+
+void PipelineBuilder::set_create_flags(VkPipelineCreateFlags flags) {
+  _flags = flags;
+}
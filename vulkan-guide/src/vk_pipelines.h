@@ -19,6 +19,7 @@ public:
   VkPipelineDepthStencilStateCreateInfo _depthStencil;
   VkPipelineRenderingCreateInfo _renderInfo;
   VkFormat _colorAttachmentformat;
+  VkPipelineCreateFlags _flags;
 
   PipelineBuilder() { clear(); }
 
@@ -49,4 +50,7 @@ public:
   void enable_blending_additive();
 
   void enable_blending_alphablend();
+
+  // e.g. DESCRIPTOR_BUFFER_BIT for layouts bound from descriptor buffers
+  void set_create_flags(VkPipelineCreateFlags flags);
 };
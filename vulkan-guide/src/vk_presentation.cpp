@@ -0,0 +1,98 @@
+#include <vk_presentation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+const char *present_policy_name(PresentPolicy policy) {
+  switch (policy) {
+  case PresentPolicy::Fifo:
+    return "fifo";
+  case PresentPolicy::Mailbox:
+    return "mailbox";
+  case PresentPolicy::Immediate:
+    return "immediate";
+  case PresentPolicy::FifoRelaxed:
+    return "fifo_relaxed";
+  }
+  return "unknown";
+}
+
+bool parse_present_policy(std::string_view name, PresentPolicy &outPolicy) {
+  for (PresentPolicy policy :
+       {PresentPolicy::Fifo, PresentPolicy::Mailbox, PresentPolicy::Immediate,
+        PresentPolicy::FifoRelaxed}) {
+    if (name == present_policy_name(policy)) {
+      outPolicy = policy;
+      return true;
+    }
+  }
+  return false;
+}
+
+VkPresentModeKHR choose_present_mode(VkPhysicalDevice gpu, VkSurfaceKHR surface,
+                                     PresentPolicy policy) {
+  uint32_t modeCount = 0;
+  VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &modeCount,
+                                                     nullptr));
+  std::vector<VkPresentModeKHR> supported(modeCount);
+  VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &modeCount,
+                                                     supported.data()));
+
+  // preferred modes for each policy, best first. FIFO ends every list
+  std::vector<VkPresentModeKHR> candidates;
+  switch (policy) {
+  case PresentPolicy::Mailbox:
+    candidates = {VK_PRESENT_MODE_MAILBOX_KHR};
+    break;
+  case PresentPolicy::Immediate:
+    candidates = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+    break;
+  case PresentPolicy::FifoRelaxed:
+    candidates = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+    break;
+  case PresentPolicy::Fifo:
+    break;
+  }
+
+  for (VkPresentModeKHR mode : candidates) {
+    if (std::find(supported.begin(), supported.end(), mode) !=
+        supported.end()) {
+      return mode;
+    }
+  }
+
+  if (policy != PresentPolicy::Fifo) {
+    fmt::println("present policy {} not supported, falling back to fifo",
+                 present_policy_name(policy));
+  }
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t FrameLimiter::queued_frame_budget(double gpuFrameMs,
+                                           uint32_t framesInFlight) const {
+  if (targetLatencyMs <= 0.f || gpuFrameMs <= 0.0) {
+    return framesInFlight;
+  }
+
+  // every queued frame adds roughly one gpu frame of latency
+  uint32_t budget = static_cast<uint32_t>(targetLatencyMs / gpuFrameMs);
+  return std::clamp(budget, 1u, framesInFlight);
+}
+
+void FrameLimiter::wait_for_frame_cap() {
+  auto now = std::chrono::high_resolution_clock::now();
+
+  if (targetFps > 0.f) {
+    auto frameTime = std::chrono::duration_cast<
+        std::chrono::high_resolution_clock::duration>(
+        std::chrono::duration<double>(1.0 / targetFps));
+    auto nextFrameStart = lastFrameStart + frameTime;
+    if (now < nextFrameStart) {
+      std::this_thread::sleep_until(nextFrameStart);
+      now = std::chrono::high_resolution_clock::now();
+    }
+  }
+
+  lastFrameStart = now;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <string_view>
+
+#include <vk_stats.h>
+#include <vk_types.h>
+
+// what the swapchain should optimize for. the policy is resolved to a present
+// mode the surface supports, see choose_present_mode
+enum class PresentPolicy : uint8_t {
+  // vsync, never tears, always available
+  Fifo,
+  // vsync without blocking, the newest frame replaces the queued one
+  Mailbox,
+  // no vsync, lowest latency, tears
+  Immediate,
+  // vsync, but late frames are presented right away and may tear
+  FifoRelaxed
+};
+
+const char *present_policy_name(PresentPolicy policy);
+
+// parses fifo / mailbox / immediate / fifo_relaxed
+bool parse_present_policy(std::string_view name, PresentPolicy &outPolicy);
+
+// picks the present mode for the policy, falling back along the closest
+// supported modes and finally FIFO, which every surface supports
+VkPresentModeKHR choose_present_mode(VkPhysicalDevice gpu, VkSurfaceKHR surface,
+                                     PresentPolicy policy);
+
+// paces the cpu so it does not queue more work than the latency target
+// allows. both limits are off by default
+struct FrameLimiter {
+  // caps the frame rate, 0 disables the cap
+  float targetFps{0.f};
+  // target for the time between the cpu starting a frame and the gpu
+  // finishing it, 0 lets the cpu run a full set of frames in flight ahead
+  float targetLatencyMs{0.f};
+
+  std::chrono::high_resolution_clock::time_point lastFrameStart{};
+
+  // how many frames may still be running on the gpu when the cpu starts a
+  // new one, given the recent gpu frame time. between 1 and framesInFlight
+  uint32_t queued_frame_budget(double gpuFrameMs,
+                               uint32_t framesInFlight) const;
+
+  // sleeps until the frame rate cap allows the next frame to start
+  void wait_for_frame_cap();
+};
+
+// cpu side presentation timings, all in ms
+struct PresentStats {
+  // blocked in vkAcquireNextImageKHR
+  RollingSamples acquireWait;
+  // blocked on the frame timeline before reusing a frame slot
+  RollingSamples frameWait;
+  // blocked in the frame limiter
+  RollingSamples pacingWait;
+  // time between two vkQueuePresentKHR calls
+  RollingSamples presentInterval;
+
+  std::chrono::high_resolution_clock::time_point lastPresent{};
+};
@@ -0,0 +1,126 @@
+#include <vk_profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+struct ThreadRing {
+  std::string name;
+  uint32_t threadId;
+  uint32_t depth{0};
+  // events written so far, the newest RING_CAPACITY of them are kept
+  std::atomic<uint64_t> written{0};
+  std::vector<profiler::ZoneEvent> events;
+};
+
+// rings outlive their threads, so a trace still shows finished threads
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadRing>> rings;
+  std::chrono::steady_clock::time_point epoch{
+      std::chrono::steady_clock::now()};
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+thread_local ThreadRing *t_ring = nullptr;
+
+ThreadRing &thread_ring() {
+  if (!t_ring) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    auto ring = std::make_unique<ThreadRing>();
+    ring->threadId = static_cast<uint32_t>(reg.rings.size());
+    ring->name = fmt::format("thread {}", ring->threadId);
+    ring->events.resize(profiler::RING_CAPACITY);
+    t_ring = ring.get();
+    reg.rings.push_back(std::move(ring));
+  }
+  return *t_ring;
+}
+} // namespace
+
+uint64_t profiler::now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - registry().epoch)
+      .count();
+}
+
+void profiler::set_thread_name(const char *name) {
+  ThreadRing &ring = thread_ring();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  ring.name = name;
+}
+
+profiler::ScopedZone::ScopedZone(const char *name) : _name(name) {
+  // the first zone of a thread allocates its ring, keep that out of the zone
+  thread_ring().depth++;
+  _startNs = now_ns();
+}
+
+profiler::ScopedZone::~ScopedZone() {
+  uint64_t endNs = now_ns();
+  ThreadRing &ring = thread_ring();
+  ring.depth--;
+
+  uint64_t index = ring.written.load(std::memory_order_relaxed);
+  ring.events[index % RING_CAPACITY] = {_name, _startNs, endNs, ring.depth};
+  ring.written.store(index + 1, std::memory_order_release);
+}
+
+bool profiler::write_chrome_trace(const char *path) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  auto separator = [&]() {
+    if (!first) {
+      file << ",\n";
+    }
+    first = false;
+  };
+
+  size_t eventCount = 0;
+  for (const std::unique_ptr<ThreadRing> &ring : reg.rings) {
+    separator();
+    file << fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                        "\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                        ring->threadId, ring->name);
+
+    uint64_t written = ring->written.load(std::memory_order_acquire);
+    uint64_t begin = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+    for (uint64_t i = begin; i < written; i++) {
+      const ZoneEvent &event = ring->events[i % RING_CAPACITY];
+      // complete events, timestamps in microseconds
+      separator();
+      file << fmt::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,"
+                          "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                          event.name, ring->threadId, event.startNs / 1000.0,
+                          (event.endNs - event.startNs) / 1000.0);
+      eventCount++;
+    }
+  }
+
+  file << "\n]}\n";
+
+  fmt::print("wrote {} profiler events to {}\n", eventCount, path);
+  return true;
+}
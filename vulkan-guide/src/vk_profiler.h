@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+// cpu profiler. zones are recorded into a ring buffer per thread, so the
+// newest events are kept and older ones get overwritten. the zone macros
+// only exist in builds with ENGINE_PROFILING, which Debug defines and the
+// ENGINE_PROFILING cmake option turns on for every configuration
+namespace profiler {
+
+// a closed zone, times are ns since the profiler started
+struct ZoneEvent {
+  const char *name;
+  uint64_t startNs;
+  uint64_t endNs;
+  // nesting level on its thread, 0 for outermost zones
+  uint32_t depth;
+};
+
+// events kept per thread before the oldest are overwritten
+constexpr uint32_t RING_CAPACITY = 1 << 15;
+
+uint64_t now_ns();
+
+// names the calling thread in exported traces
+void set_thread_name(const char *name);
+
+// writes the recorded events in the chrome trace event format, viewable in
+// chrome://tracing or ui.perfetto.dev. threads keep recording while this
+// runs, so call it between frames when the job system is idle
+bool write_chrome_trace(const char *path);
+
+class ScopedZone {
+public:
+  // name has to outlive the profiler, string literals and __func__ do
+  explicit ScopedZone(const char *name);
+  ~ScopedZone();
+
+  ScopedZone(const ScopedZone &) = delete;
+  ScopedZone &operator=(const ScopedZone &) = delete;
+
+private:
+  const char *_name;
+  uint64_t _startNs;
+};
+
+} // namespace profiler
+
+#ifdef ENGINE_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  profiler::ScopedZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,60 @@
+#include <vk_range_allocator.h>
+
+#include <algorithm>
+
+void RangeAllocator::init(uint32_t capacity) {
+  _capacity = capacity;
+  _used = 0;
+  _free.clear();
+  if (capacity > 0) {
+    _free.push_back({0, capacity});
+  }
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t &outOffset) {
+  if (count == 0) {
+    outOffset = 0;
+    return true;
+  }
+
+  for (size_t i = 0; i < _free.size(); i++) {
+    Range &range = _free[i];
+    if (range.count < count) {
+      continue;
+    }
+
+    outOffset = range.offset;
+    range.offset += count;
+    range.count -= count;
+    if (range.count == 0) {
+      _free.erase(_free.begin() + i);
+    }
+    _used += count;
+    return true;
+  }
+  return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  _used -= count;
+
+  auto next = std::lower_bound(
+      _free.begin(), _free.end(), offset,
+      [](const Range &range, uint32_t value) { return range.offset < value; });
+  auto inserted = _free.insert(next, {offset, count});
+
+  // merge with the following range, then with the preceding one
+  if (inserted + 1 != _free.end() &&
+      inserted->offset + inserted->count == (inserted + 1)->offset) {
+    inserted->count += (inserted + 1)->count;
+    _free.erase(inserted + 1);
+  }
+  if (inserted != _free.begin() &&
+      (inserted - 1)->offset + (inserted - 1)->count == inserted->offset) {
+    (inserted - 1)->count += inserted->count;
+    _free.erase(inserted);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// first fit free list over [0, capacity). neighbouring free ranges are
+// merged when a range is freed
+class RangeAllocator {
+public:
+  void init(uint32_t capacity);
+
+  // false if no free range is large enough
+  bool allocate(uint32_t count, uint32_t &outOffset);
+  void free(uint32_t offset, uint32_t count);
+
+  uint32_t capacity() const { return _capacity; }
+  uint32_t used() const { return _used; }
+
+private:
+  struct Range {
+    uint32_t offset;
+    uint32_t count;
+  };
+
+  uint32_t _capacity{0};
+  uint32_t _used{0};
+  // sorted by offset, never adjacent
+  std::vector<Range> _free;
+};
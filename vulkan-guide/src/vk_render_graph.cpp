@@ -0,0 +1,365 @@
+#include <vk_render_graph.h>
+
+#include <vk_initializers.h>
+
+namespace {
+struct UsageInfo {
+  VkPipelineStageFlags2 stages;
+  VkAccessFlags2 access;
+  VkImageLayout layout;
+  bool writes;
+  // false when the usage overwrites the whole resource, so whatever was in
+  // it before can be discarded
+  bool readsContents;
+};
+
+UsageInfo usage_info(ResourceUsage usage) {
+  switch (usage) {
+  case ResourceUsage::ComputeStorageWrite:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+            true, false};
+  case ResourceUsage::ComputeStorageRead:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false,
+            true};
+  case ResourceUsage::ColorAttachment:
+    return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true};
+  case ResourceUsage::DepthAttachment:
+    return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true, false};
+  case ResourceUsage::FragmentSampled:
+    return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, true};
+  case ResourceUsage::TransferSrc:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, true};
+  case ResourceUsage::TransferDst:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false};
+  case ResourceUsage::Present:
+    // the present engine waits on a semaphore, no stage needs to wait here
+    return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, true};
+  case ResourceUsage::HostRead:
+    return {VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, false, true};
+  case ResourceUsage::None:
+    break;
+  }
+  return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED,
+          false, true};
+}
+
+constexpr VkAccessFlags2 WRITE_ACCESS =
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT;
+} // namespace
+
+void RenderGraph::reset() {
+  _resources.clear();
+  _passes.clear();
+}
+
+RGResource RenderGraph::import_image(const char *name, VkImage image,
+                                     VkImageAspectFlags aspect,
+                                     VkImageLayout initialLayout,
+                                     VkPipelineStageFlags2 initialStages) {
+  Resource resource;
+  resource.name = name;
+  resource.image = image;
+  resource.aspect = aspect;
+  resource.layout = initialLayout;
+  // whatever used the image before counts as a write, so the first use
+  // waits on those stages and makes their writes available
+  resource.writeStages = initialStages;
+  resource.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+  _resources.push_back(resource);
+  return static_cast<RGResource>(_resources.size() - 1);
+}
+
+RGResource RenderGraph::import_buffer(const char *name, VkBuffer buffer,
+                                      VkPipelineStageFlags2 initialStages) {
+  Resource resource;
+  resource.name = name;
+  resource.buffer = buffer;
+  resource.writeStages = initialStages;
+  resource.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+  _resources.push_back(resource);
+  return static_cast<RGResource>(_resources.size() - 1);
+}
+
+RGResource RenderGraph::create_image(const char *name,
+                                     const TransientImageDesc &desc) {
+  Resource resource;
+  resource.name = name;
+  resource.aspect = desc.aspect;
+  resource.transient = true;
+  resource.request.isImage = true;
+  resource.request.image = desc;
+
+  _resources.push_back(resource);
+  return static_cast<RGResource>(_resources.size() - 1);
+}
+
+RGResource RenderGraph::create_buffer(const char *name,
+                                      const TransientBufferDesc &desc) {
+  Resource resource;
+  resource.name = name;
+  resource.transient = true;
+  resource.request.isImage = false;
+  resource.request.buffer = desc;
+
+  _resources.push_back(resource);
+  return static_cast<RGResource>(_resources.size() - 1);
+}
+
+void RenderGraph::export_resource(RGResource resource,
+                                  ResourceUsage finalUsage) {
+  _resources[resource].exported = true;
+  _resources[resource].finalUsage = finalUsage;
+}
+
+void RenderGraph::add_pass(const char *name,
+                           std::initializer_list<RGAccess> accesses,
+                           std::function<void(VkCommandBuffer)> &&execute) {
+  Pass pass;
+  pass.name = name;
+  pass.accesses = accesses;
+  pass.execute = std::move(execute);
+  _passes.push_back(std::move(pass));
+}
+
+void RenderGraph::cull_passes() {
+  // walk back from the exported resources. a pass is kept if it writes
+  // something a later kept pass or the outside world still needs
+  std::vector<bool> needed(_resources.size());
+  for (size_t i = 0; i < _resources.size(); i++) {
+    needed[i] = _resources[i].exported;
+  }
+
+  for (auto pass = _passes.rbegin(); pass != _passes.rend(); pass++) {
+    bool live = false;
+    for (const RGAccess &access : pass->accesses) {
+      if (usage_info(access.usage).writes && needed[access.resource]) {
+        live = true;
+      }
+    }
+
+    pass->culled = !live;
+    if (!live) {
+      continue;
+    }
+
+    // a full overwrite makes earlier contents irrelevant, what the pass
+    // reads has to be produced by someone before it
+    for (const RGAccess &access : pass->accesses) {
+      UsageInfo info = usage_info(access.usage);
+      if (info.writes && !info.readsContents) {
+        needed[access.resource] = false;
+      }
+    }
+    for (const RGAccess &access : pass->accesses) {
+      if (usage_info(access.usage).readsContents) {
+        needed[access.resource] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::allocate_transients(TransientAllocator &transients) {
+  _transientRequests.clear();
+  _transientResources.clear();
+
+  constexpr uint32_t unused = UINT32_MAX;
+  std::vector<uint32_t> firstPass(_resources.size(), unused);
+  std::vector<uint32_t> lastPass(_resources.size(), unused);
+  for (uint32_t p = 0; p < _passes.size(); p++) {
+    if (_passes[p].culled) {
+      continue;
+    }
+    for (const RGAccess &access : _passes[p].accesses) {
+      if (firstPass[access.resource] == unused) {
+        firstPass[access.resource] = p;
+      }
+      lastPass[access.resource] = p;
+    }
+  }
+
+  for (uint32_t r = 0; r < _resources.size(); r++) {
+    Resource &resource = _resources[r];
+    if (!resource.transient || firstPass[r] == unused) {
+      continue;
+    }
+    resource.request.firstPass = firstPass[r];
+    resource.request.lastPass = lastPass[r];
+    _transientRequests.push_back(resource.request);
+    _transientResources.push_back(r);
+  }
+
+  std::span<const TransientResource> allocated =
+      transients.allocate(_transientRequests);
+
+  for (size_t i = 0; i < _transientResources.size(); i++) {
+    Resource &resource = _resources[_transientResources[i]];
+    resource.image = allocated[i].image;
+    resource.view = allocated[i].view;
+    resource.buffer = allocated[i].buffer;
+    // the memory may have belonged to another resource in an earlier pass,
+    // so the first use waits on everything before it like an import does
+    resource.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    resource.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+  }
+}
+
+void RenderGraph::transition(Resource &resource, ResourceUsage usage) {
+  if (usage == ResourceUsage::None) {
+    return;
+  }
+
+  UsageInfo info = usage_info(usage);
+  bool isImage = resource.image != VK_NULL_HANDLE;
+  bool layoutChange = isImage && info.layout != resource.layout;
+
+  VkPipelineStageFlags2 srcStages = 0;
+  VkAccessFlags2 srcAccess = 0;
+  bool needsBarrier = false;
+
+  if (info.writes || layoutChange) {
+    // writes and layout transitions wait for earlier reads to finish and
+    // for earlier writes to be available
+    srcStages = resource.writeStages | resource.readStages;
+    srcAccess = resource.writeAccess;
+    needsBarrier = srcStages != 0 || layoutChange;
+  } else if (resource.writeStages != 0) {
+    // a read only needs the last write made visible, unless a barrier
+    // since then already covered these stages
+    bool visible = (info.stages & ~resource.visibleStages) == 0 &&
+                   (info.access & ~resource.visibleAccess) == 0;
+    if (!visible) {
+      srcStages = resource.writeStages;
+      srcAccess = resource.writeAccess;
+      needsBarrier = true;
+    }
+  }
+
+  if (needsBarrier) {
+    if (isImage) {
+      VkImageMemoryBarrier2 barrier{
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+      barrier.srcStageMask = srcStages;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstStageMask = info.stages;
+      barrier.dstAccessMask = info.access;
+      // transitioning from UNDEFINED lets the driver skip preserving texels
+      // the pass overwrites anyway
+      barrier.oldLayout = (layoutChange && !info.readsContents)
+                              ? VK_IMAGE_LAYOUT_UNDEFINED
+                              : resource.layout;
+      barrier.newLayout = info.layout;
+      barrier.image = resource.image;
+      barrier.subresourceRange =
+          vkinit::image_subresource_range(resource.aspect);
+      _imageBarriers.push_back(barrier);
+    } else {
+      VkBufferMemoryBarrier2 barrier{
+          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+      barrier.srcStageMask = srcStages;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstStageMask = info.stages;
+      barrier.dstAccessMask = info.access;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = resource.buffer;
+      barrier.offset = 0;
+      barrier.size = VK_WHOLE_SIZE;
+      _bufferBarriers.push_back(barrier);
+    }
+  }
+
+  if (info.writes || layoutChange) {
+    // a layout transition counts as a write in the stages that waited for it
+    resource.writeStages = info.stages;
+    resource.writeAccess = info.access & WRITE_ACCESS;
+    resource.visibleStages = info.stages;
+    resource.visibleAccess = info.access;
+    resource.readStages = info.writes ? 0 : info.stages;
+  } else {
+    resource.readStages |= info.stages;
+    if (needsBarrier) {
+      resource.visibleStages |= info.stages;
+      resource.visibleAccess |= info.access;
+    }
+  }
+
+  if (isImage) {
+    resource.layout = info.layout;
+  }
+}
+
+void RenderGraph::flush_barriers(VkCommandBuffer cmd) {
+  if (_imageBarriers.empty() && _bufferBarriers.empty()) {
+    return;
+  }
+
+  VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  depInfo.imageMemoryBarrierCount =
+      static_cast<uint32_t>(_imageBarriers.size());
+  depInfo.pImageMemoryBarriers = _imageBarriers.data();
+  depInfo.bufferMemoryBarrierCount =
+      static_cast<uint32_t>(_bufferBarriers.size());
+  depInfo.pBufferMemoryBarriers = _bufferBarriers.data();
+
+  vkCmdPipelineBarrier2(cmd, &depInfo);
+
+  _stats.barrierBatches++;
+  _stats.imageBarriers += depInfo.imageMemoryBarrierCount;
+  _stats.bufferBarriers += depInfo.bufferMemoryBarrierCount;
+
+  _imageBarriers.clear();
+  _bufferBarriers.clear();
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd,
+                          TransientAllocator &transients) {
+  _stats = {};
+  _stats.passes = static_cast<uint32_t>(_passes.size());
+
+  cull_passes();
+  allocate_transients(transients);
+
+  for (Pass &pass : _passes) {
+    if (pass.culled) {
+      _stats.culledPasses++;
+      continue;
+    }
+
+    for (const RGAccess &access : pass.accesses) {
+      transition(_resources[access.resource], access.usage);
+    }
+    flush_barriers(cmd);
+
+    pass.execute(cmd);
+  }
+
+  // leave the exported resources the way the outside world expects them
+  for (Resource &resource : _resources) {
+    if (resource.exported) {
+      transition(resource, resource.finalUsage);
+    }
+  }
+  flush_barriers(cmd);
+}
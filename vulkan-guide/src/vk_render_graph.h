@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vk_transient_allocator.h>
+#include <vk_types.h>
+
+// how a pass uses a resource. every usage maps to the stages, access and
+// image layout the graph synchronizes against, see vk_render_graph.cpp
+enum class ResourceUsage : uint8_t {
+  // compute shader writes every texel, the old contents are discarded
+  ComputeStorageWrite,
+  ComputeStorageRead,
+  // color attachment with LOAD_OP_LOAD, keeps what earlier passes drew
+  ColorAttachment,
+  // depth attachment with LOAD_OP_CLEAR, the old contents are discarded
+  DepthAttachment,
+  FragmentSampled,
+  TransferSrc,
+  // copy or blit destination covering the whole resource
+  TransferDst,
+  // final usages for exported resources
+  Present,
+  HostRead,
+  // keeps the resource in whatever state the last pass left it
+  None
+};
+
+// index of a resource in the graph it was imported into
+using RGResource = uint32_t;
+
+struct RGAccess {
+  RGResource resource;
+  ResourceUsage usage;
+};
+
+// the passes of one frame. passes declare which resources they read and
+// write, execute() then culls the passes nothing depends on and records the
+// rest, each preceded by a single batch of barriers derived from the
+// declared usages
+class RenderGraph {
+public:
+  // drops the passes and resources of the previous frame, keeps allocations
+  void reset();
+
+  // images and buffers owned by the engine. initialStages are the stages
+  // that may still use the resource when the graph starts, and have to
+  // cover any semaphore wait on it. an UNDEFINED layout discards contents
+  RGResource import_image(const char *name, VkImage image,
+                          VkImageAspectFlags aspect,
+                          VkImageLayout initialLayout,
+                          VkPipelineStageFlags2 initialStages);
+  RGResource import_buffer(const char *name, VkBuffer buffer,
+                           VkPipelineStageFlags2 initialStages);
+
+  // resources that only live inside the frame. execute() allocates them
+  // from the transient allocator once it knows which passes use them, they
+  // can't be exported
+  RGResource create_image(const char *name, const TransientImageDesc &desc);
+  RGResource create_buffer(const char *name, const TransientBufferDesc &desc);
+
+  // handles for the pass callbacks, transient ones are only valid during
+  // execute(). image_view only exists for transient images
+  VkImage image(RGResource resource) const {
+    return _resources[resource].image;
+  }
+  VkImageView image_view(RGResource resource) const {
+    return _resources[resource].view;
+  }
+  VkBuffer buffer(RGResource resource) const {
+    return _resources[resource].buffer;
+  }
+
+  // the resource is used after the graph, so the passes producing it are
+  // kept. it is transitioned to the final usage after the last pass
+  void export_resource(RGResource resource, ResourceUsage finalUsage);
+
+  // passes run in the order they are added. a resource may appear once per
+  // pass
+  void add_pass(const char *name, std::initializer_list<RGAccess> accesses,
+                std::function<void(VkCommandBuffer)> &&execute);
+
+  void execute(VkCommandBuffer cmd, TransientAllocator &transients);
+
+  // what the last execute() did
+  struct Stats {
+    uint32_t passes{0};
+    uint32_t culledPasses{0};
+    uint32_t barrierBatches{0};
+    uint32_t imageBarriers{0};
+    uint32_t bufferBarriers{0};
+  };
+  const Stats &stats() const { return _stats; }
+
+private:
+  struct Resource {
+    const char *name;
+    VkImage image{VK_NULL_HANDLE};
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkImageAspectFlags aspect{0};
+    VkImageView view{VK_NULL_HANDLE};
+
+    bool transient{false};
+    TransientRequest request;
+
+    // synchronization state while recording
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    // the last write, or layout transition, and the stages and access it
+    // has been made visible to since
+    VkPipelineStageFlags2 writeStages{0};
+    VkAccessFlags2 writeAccess{0};
+    VkPipelineStageFlags2 visibleStages{0};
+    VkAccessFlags2 visibleAccess{0};
+    // reads since the last write, a write has to wait for them
+    VkPipelineStageFlags2 readStages{0};
+
+    bool exported{false};
+    ResourceUsage finalUsage{ResourceUsage::None};
+  };
+
+  struct Pass {
+    const char *name;
+    std::vector<RGAccess> accesses;
+    std::function<void(VkCommandBuffer)> execute;
+    bool culled{false};
+  };
+
+  void cull_passes();
+  // lifetimes of the transient resources over the passes that survived
+  // culling, then memory for them
+  void allocate_transients(TransientAllocator &transients);
+  // adds the barriers needed before the resource can be used as given
+  void transition(Resource &resource, ResourceUsage usage);
+  void flush_barriers(VkCommandBuffer cmd);
+
+  std::vector<Resource> _resources;
+  std::vector<Pass> _passes;
+
+  std::vector<TransientRequest> _transientRequests;
+  std::vector<RGResource> _transientResources;
+
+  std::vector<VkImageMemoryBarrier2> _imageBarriers;
+  std::vector<VkBufferMemoryBarrier2> _bufferBarriers;
+
+  Stats _stats;
+};
@@ -0,0 +1,137 @@
+#include <vk_retirement.h>
+
+const char *resource_type_name(ResourceType type) {
+  switch (type) {
+  case ResourceType::Buffer:
+    return "buffer";
+  case ResourceType::Image:
+    return "image";
+  case ResourceType::ImageView:
+    return "image view";
+  case ResourceType::Memory:
+    return "memory";
+  case ResourceType::Swapchain:
+    return "swapchain";
+  case ResourceType::DescriptorPool:
+    return "descriptor pool";
+  }
+  return "unknown";
+}
+
+void RetirementQueue::init(VkDevice device, VmaAllocator allocator,
+                           MemoryTelemetry *telemetry) {
+  _device = device;
+  _allocator = allocator;
+  _telemetry = telemetry;
+}
+
+void RetirementQueue::flush() {
+  for (const RetiredResource &resource : _retired) {
+    destroy(resource);
+  }
+  _retired.clear();
+}
+
+void RetirementQueue::retire(ResourceType type, uint64_t handle,
+                             VmaAllocation allocation) {
+  if (handle == 0) {
+    return;
+  }
+  _retired.push_back({type, handle, allocation, _submittedValue});
+}
+
+void RetirementQueue::retire_image(const AllocatedImage &image) {
+  untrack(resource_handle(image.image));
+  retire(ResourceType::ImageView, resource_handle(image.imageView));
+  retire(ResourceType::Image, resource_handle(image.image), image.allocation);
+}
+
+void RetirementQueue::retire_buffer(const AllocatedBuffer &buffer) {
+  untrack(resource_handle(buffer.buffer));
+  retire(ResourceType::Buffer, resource_handle(buffer.buffer),
+         buffer.allocation);
+}
+
+void RetirementQueue::collect(uint64_t completedValue) {
+  size_t count = 0;
+  while (count < _retired.size() &&
+         _retired[count].retireValue <= completedValue) {
+    destroy(_retired[count]);
+    count++;
+  }
+  _retired.erase(_retired.begin(), _retired.begin() + count);
+}
+
+void RetirementQueue::track(ResourceType type, uint64_t handle,
+                            VkDeviceSize size, MemoryCategory category) {
+  std::lock_guard<std::mutex> lock(_trackMutex);
+  _live[handle] = {type, category, size, _submittedValue};
+  _telemetry->add(category, size);
+}
+
+void RetirementQueue::untrack(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(_trackMutex);
+  auto it = _live.find(handle);
+  if (it == _live.end()) {
+    return;
+  }
+  _telemetry->remove(it->second.category, it->second.size);
+  _live.erase(it);
+}
+
+void RetirementQueue::retrack(uint64_t oldHandle, uint64_t newHandle) {
+  std::lock_guard<std::mutex> lock(_trackMutex);
+  auto it = _live.find(oldHandle);
+  if (it == _live.end()) {
+    return;
+  }
+  TrackedResource resource = it->second;
+  _live.erase(it);
+  _live[newHandle] = resource;
+}
+
+size_t RetirementQueue::report_leaks() {
+  std::lock_guard<std::mutex> lock(_trackMutex);
+  for (const auto &[handle, resource] : _live) {
+    fmt::println("leaked {} {:#x}, {} bytes of {}, created after frame {}",
+                 resource_type_name(resource.type), handle, resource.size,
+                 memory_category_name(resource.category),
+                 resource.createdValue);
+  }
+  if (!_live.empty()) {
+    fmt::println("{} resources were never destroyed or retired",
+                 _live.size());
+  }
+  return _live.size();
+}
+
+void RetirementQueue::destroy(const RetiredResource &resource) {
+  switch (resource.type) {
+  case ResourceType::Buffer:
+    vmaDestroyBuffer(_allocator, (VkBuffer)resource.handle,
+                     resource.allocation);
+    break;
+  case ResourceType::Image:
+    if (resource.allocation != VK_NULL_HANDLE) {
+      vmaDestroyImage(_allocator, (VkImage)resource.handle,
+                      resource.allocation);
+    } else {
+      vkDestroyImage(_device, (VkImage)resource.handle, nullptr);
+    }
+    break;
+  case ResourceType::ImageView:
+    vkDestroyImageView(_device, (VkImageView)resource.handle, nullptr);
+    break;
+  case ResourceType::Memory:
+    vmaFreeMemory(_allocator, (VmaAllocation)resource.handle);
+    break;
+  case ResourceType::Swapchain:
+    vkDestroySwapchainKHR(_device, (VkSwapchainKHR)resource.handle, nullptr);
+    break;
+  case ResourceType::DescriptorPool:
+    vkDestroyDescriptorPool(_device, (VkDescriptorPool)resource.handle,
+                            nullptr);
+    break;
+  }
+  _destroyed++;
+}
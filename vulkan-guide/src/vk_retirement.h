@@ -0,0 +1,100 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+
+#include <vk_memory_telemetry.h>
+#include <vk_types.h>
+
+enum class ResourceType : uint8_t {
+  Buffer,
+  Image,
+  ImageView,
+  // a VmaAllocation without a resource of its own
+  Memory,
+  Swapchain,
+  DescriptorPool,
+};
+
+const char *resource_type_name(ResourceType type);
+
+// non dispatchable handles are pointers or uint64_t depending on the
+// platform, records keep them as uint64_t
+template <typename T> uint64_t resource_handle(T handle) {
+  return (uint64_t)handle;
+}
+
+// a resource the gpu may use until the frame timeline reaches retireValue
+struct RetiredResource {
+  ResourceType type;
+  uint64_t handle;
+  VmaAllocation allocation;
+  uint64_t retireValue;
+};
+
+// destroys resources replaced while frames are in flight. a retired
+// resource waits for the newest frame submitted before it was retired, and
+// is destroyed by the first collect() that sees the timeline past it. the
+// records are plain structs in retire order, so retiring doesn't allocate
+// once the queue has grown to its working size.
+// also tracks the buffers and images the engine creates, and counts their
+// memory in its category until they are destroyed or retired. whatever is
+// neither destroyed nor retired by shutdown is listed by report_leaks()
+class RetirementQueue {
+public:
+  void init(VkDevice device, VmaAllocator allocator,
+            MemoryTelemetry *telemetry);
+  // destroys everything still queued, the device has to be idle
+  void flush();
+
+  // retirements from here on wait for value. called after every frame
+  // submit with the value the frame signals
+  void set_submitted_value(uint64_t value) { _submittedValue = value; }
+  uint64_t submitted_value() const { return _submittedValue; }
+
+  void retire(ResourceType type, uint64_t handle,
+              VmaAllocation allocation = VK_NULL_HANDLE);
+  // the view first, then the image and its memory
+  void retire_image(const AllocatedImage &image);
+  void retire_buffer(const AllocatedBuffer &buffer);
+
+  // destroys every resource the timeline has passed, in retire order
+  void collect(uint64_t completedValue);
+
+  // records a live resource for the leak report. thread safe
+  void track(ResourceType type, uint64_t handle, VkDeviceSize size,
+             MemoryCategory category);
+  // the resource was destroyed. thread safe
+  void untrack(uint64_t handle);
+  // the resource was replaced by a copy in the same memory, which keeps its
+  // record. thread safe
+  void retrack(uint64_t oldHandle, uint64_t newHandle);
+  // prints the tracked resources still alive and returns their count
+  size_t report_leaks();
+
+  size_t pending() const { return _retired.size(); }
+  uint64_t destroyed() const { return _destroyed; }
+
+private:
+  struct TrackedResource {
+    ResourceType type;
+    MemoryCategory category;
+    VkDeviceSize size;
+    // the newest submitted frame when it was created
+    uint64_t createdValue;
+  };
+
+  void destroy(const RetiredResource &resource);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  MemoryTelemetry *_telemetry{nullptr};
+
+  uint64_t _submittedValue{0};
+  // retireValue never decreases along the queue
+  std::vector<RetiredResource> _retired;
+  uint64_t _destroyed{0};
+
+  std::mutex _trackMutex;
+  std::unordered_map<uint64_t, TrackedResource> _live;
+};
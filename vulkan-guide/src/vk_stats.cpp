@@ -0,0 +1,84 @@
+#include <vk_stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <fmt/core.h>
+
+namespace {
+// nearest-rank percentile on an already sorted array
+double sorted_percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  rank = std::clamp<size_t>(rank, 1, sorted.size());
+  return sorted[rank - 1];
+}
+} // namespace
+
+SampleSummary summarize_samples(std::vector<double> samples) {
+  SampleSummary summary;
+  summary.count = samples.size();
+  if (samples.empty()) {
+    return summary;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  summary.min = samples.front();
+  summary.max = samples.back();
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                 static_cast<double>(samples.size());
+  summary.p50 = sorted_percentile(samples, 0.50);
+  summary.p90 = sorted_percentile(samples, 0.90);
+  summary.p95 = sorted_percentile(samples, 0.95);
+  summary.p99 = sorted_percentile(samples, 0.99);
+
+  return summary;
+}
+
+void RollingSamples::push(double value) {
+  if (count == capacity) {
+    sum -= samples[next];
+  }
+  sum += value;
+  samples[next] = value;
+  next = (next + 1) % capacity;
+  count = std::min(count + 1, capacity);
+
+  // once per lap, so the rounding of the running sum doesn't accumulate
+  if (next == 0) {
+    sum = 0;
+    for (size_t i = 0; i < count; i++) {
+      sum += samples[i];
+    }
+  }
+}
+
+void RollingSamples::clear() {
+  count = 0;
+  next = 0;
+  sum = 0;
+}
+
+double RollingSamples::last() const {
+  if (count == 0) {
+    return 0;
+  }
+  return samples[(next + capacity - 1) % capacity];
+}
+
+SampleSummary RollingSamples::summary() const {
+  return summarize_samples(
+      std::vector<double>(samples.begin(), samples.begin() + count));
+}
+
+void print_sample_summary(std::string_view label,
+                          const SampleSummary &summary) {
+  fmt::println("{:<12} n={:<6} mean={:8.3f} p50={:8.3f} p90={:8.3f} "
+               "p95={:8.3f} p99={:8.3f} min={:8.3f} max={:8.3f}",
+               label, summary.count, summary.mean, summary.p50, summary.p90,
+               summary.p95, summary.p99, summary.min, summary.max);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+// summary of a set of timing samples, all values in the unit of the samples
+struct SampleSummary {
+  size_t count{0};
+  double min{0};
+  double max{0};
+  double mean{0};
+  double p50{0};
+  double p90{0};
+  double p95{0};
+  double p99{0};
+};
+
+// sorts a copy of the samples and computes min/max/mean and percentiles
+SampleSummary summarize_samples(std::vector<double> samples);
+
+void print_sample_summary(std::string_view label, const SampleSummary &summary);
+
+// fixed size window over the most recent samples, for live statistics
+struct RollingSamples {
+  static constexpr size_t capacity = 256;
+
+  std::array<double, capacity> samples{};
+  size_t count{0};
+  size_t next{0};
+  // of the samples in the window
+  double sum{0};
+
+  void push(double value);
+  void clear();
+
+  // most recently pushed sample, 0 if empty
+  double last() const;
+  // without the copy and sort of summary(), 0 if empty
+  double mean() const { return count > 0 ? sum / double(count) : 0.0; }
+  SampleSummary summary() const;
+};
@@ -0,0 +1,245 @@
+#include <vk_transient_allocator.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include <vk_initializers.h>
+
+namespace {
+struct Placed {
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  uint32_t firstPass;
+  uint32_t lastPass;
+};
+
+// a memory allocation shared by the resources placed in it. images and
+// buffers get separate blocks, so linear and optimal resources never share
+// a bufferImageGranularity page
+struct Block {
+  bool images;
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  uint32_t memoryTypeBits;
+  std::vector<Placed> placed;
+  VmaAllocation allocation{VK_NULL_HANDLE};
+};
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// lowest offset in the block that doesn't overlap the memory of a resource
+// alive during any of the same passes
+bool find_offset(const Block &block, const VkMemoryRequirements &reqs,
+                 uint32_t firstPass, uint32_t lastPass,
+                 VkDeviceSize &outOffset) {
+  std::vector<VkDeviceSize> candidates{0};
+  for (const Placed &placed : block.placed) {
+    candidates.push_back(placed.offset + placed.size);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  for (VkDeviceSize candidate : candidates) {
+    VkDeviceSize offset = align_up(candidate, reqs.alignment);
+    if (offset + reqs.size > block.size) {
+      break;
+    }
+
+    bool free = true;
+    for (const Placed &placed : block.placed) {
+      bool aliveTogether =
+          firstPass <= placed.lastPass && placed.firstPass <= lastPass;
+      bool memoryOverlaps = offset < placed.offset + placed.size &&
+                            placed.offset < offset + reqs.size;
+      if (aliveTogether && memoryOverlaps) {
+        free = false;
+        break;
+      }
+    }
+
+    if (free) {
+      outOffset = offset;
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+void TransientAllocator::init(VkDevice device, VmaAllocator allocator,
+                              RetirementQueue *retirement,
+                              MemoryTelemetry *telemetry) {
+  _device = device;
+  _allocator = allocator;
+  _retirement = retirement;
+  _telemetry = telemetry;
+}
+
+void TransientAllocator::cleanup() {
+  destroy(_placement);
+  _placement = {};
+  _requests.clear();
+}
+
+std::span<const TransientResource>
+TransientAllocator::allocate(std::span<const TransientRequest> requests) {
+  if (std::equal(requests.begin(), requests.end(), _requests.begin(),
+                 _requests.end())) {
+    return _placement.resources;
+  }
+
+  // the frames in flight may still use the old placement
+  if (!_placement.resources.empty()) {
+    retire(_placement);
+  }
+
+  _placement = build(requests);
+  _requests.assign(requests.begin(), requests.end());
+  return _placement.resources;
+}
+
+TransientAllocator::Placement
+TransientAllocator::build(std::span<const TransientRequest> requests) {
+  Placement placement;
+  placement.resources.resize(requests.size());
+  std::vector<VkMemoryRequirements> reqs(requests.size());
+
+  // create the resources without memory to learn what they need
+  for (size_t i = 0; i < requests.size(); i++) {
+    const TransientRequest &request = requests[i];
+    TransientResource &resource = placement.resources[i];
+
+    if (request.isImage) {
+      VkImageCreateInfo info = vkinit::image_create_info(
+          request.image.format, request.image.usage,
+          VkExtent3D{request.image.extent.width, request.image.extent.height,
+                     1});
+      VK_CHECK(vkCreateImage(_device, &info, nullptr, &resource.image));
+      vkGetImageMemoryRequirements(_device, resource.image, &reqs[i]);
+    } else {
+      VkBufferCreateInfo info = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+      info.size = request.buffer.size;
+      info.usage = request.buffer.usage;
+      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      VK_CHECK(vkCreateBuffer(_device, &info, nullptr, &resource.buffer));
+      vkGetBufferMemoryRequirements(_device, resource.buffer, &reqs[i]);
+    }
+  }
+
+  // largest first, so the smaller resources fill the space next to the
+  // large ones instead of opening blocks of their own
+  std::vector<uint32_t> order(requests.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return reqs[a].size > reqs[b].size;
+  });
+
+  std::vector<Block> blocks;
+  std::vector<uint32_t> blockOf(requests.size());
+  std::vector<VkDeviceSize> offsetOf(requests.size());
+
+  _stats = {};
+  _stats.resources = static_cast<uint32_t>(requests.size());
+
+  for (uint32_t i : order) {
+    const TransientRequest &request = requests[i];
+    _stats.requestedBytes += reqs[i].size;
+
+    bool placed = false;
+    for (uint32_t b = 0; b < blocks.size() && !placed; b++) {
+      Block &block = blocks[b];
+      if (block.images != request.isImage ||
+          (block.memoryTypeBits & reqs[i].memoryTypeBits) == 0) {
+        continue;
+      }
+
+      VkDeviceSize offset;
+      if (find_offset(block, reqs[i], request.firstPass, request.lastPass,
+                      offset)) {
+        block.placed.push_back(
+            {offset, reqs[i].size, request.firstPass, request.lastPass});
+        block.memoryTypeBits &= reqs[i].memoryTypeBits;
+        block.alignment = std::max(block.alignment, reqs[i].alignment);
+        blockOf[i] = b;
+        offsetOf[i] = offset;
+        placed = true;
+      }
+    }
+
+    if (!placed) {
+      Block block{request.isImage, reqs[i].size, reqs[i].alignment,
+                  reqs[i].memoryTypeBits};
+      block.placed.push_back(
+          {0, reqs[i].size, request.firstPass, request.lastPass});
+      blockOf[i] = static_cast<uint32_t>(blocks.size());
+      offsetOf[i] = 0;
+      blocks.push_back(std::move(block));
+    }
+  }
+
+  VmaAllocationCreateInfo allocInfo = {};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  allocInfo.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  for (Block &block : blocks) {
+    VkMemoryRequirements blockReqs = {block.size, block.alignment,
+                                      block.memoryTypeBits};
+    VK_CHECK(vmaAllocateMemory(_allocator, &blockReqs, &allocInfo,
+                               &block.allocation, nullptr));
+    placement.blocks.push_back(block.allocation);
+    placement.bytes += block.size;
+
+    _stats.blocks++;
+    _stats.allocatedBytes += block.size;
+  }
+
+  for (size_t i = 0; i < requests.size(); i++) {
+    const TransientRequest &request = requests[i];
+    TransientResource &resource = placement.resources[i];
+    VmaAllocation block = blocks[blockOf[i]].allocation;
+
+    if (request.isImage) {
+      VK_CHECK(vmaBindImageMemory2(_allocator, block, offsetOf[i],
+                                   resource.image, nullptr));
+
+      VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(
+          request.image.format, resource.image, request.image.aspect);
+      VK_CHECK(
+          vkCreateImageView(_device, &viewInfo, nullptr, &resource.view));
+    } else {
+      VK_CHECK(vmaBindBufferMemory2(_allocator, block, offsetOf[i],
+                                    resource.buffer, nullptr));
+    }
+  }
+
+  _telemetry->add(MemoryCategory::RenderTargets, placement.bytes);
+  return placement;
+}
+
+void TransientAllocator::retire(const Placement &placement) {
+  for (const TransientResource &resource : placement.resources) {
+    _retirement->retire(ResourceType::ImageView,
+                        resource_handle(resource.view));
+    _retirement->retire(ResourceType::Image, resource_handle(resource.image));
+    _retirement->retire(ResourceType::Buffer,
+                        resource_handle(resource.buffer));
+  }
+  for (VmaAllocation block : placement.blocks) {
+    _retirement->retire(ResourceType::Memory, resource_handle(block));
+  }
+  _telemetry->remove(MemoryCategory::RenderTargets, placement.bytes);
+}
+
+void TransientAllocator::destroy(const Placement &placement) {
+  for (const TransientResource &resource : placement.resources) {
+    vkDestroyImageView(_device, resource.view, nullptr);
+    vkDestroyImage(_device, resource.image, nullptr);
+    vkDestroyBuffer(_device, resource.buffer, nullptr);
+  }
+  for (VmaAllocation block : placement.blocks) {
+    vmaFreeMemory(_allocator, block);
+  }
+  _telemetry->remove(MemoryCategory::RenderTargets, placement.bytes);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vk_retirement.h>
+#include <vk_types.h>
+
+// images and buffers that only live between two passes of a frame. their
+// memory is shared with other transient resources that aren't alive at the
+// same time
+struct TransientImageDesc {
+  VkFormat format;
+  VkExtent2D extent;
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+
+  bool operator==(const TransientImageDesc &) const = default;
+};
+
+struct TransientBufferDesc {
+  VkDeviceSize size;
+  VkBufferUsageFlags usage;
+
+  bool operator==(const TransientBufferDesc &) const = default;
+};
+
+// a transient resource and the range of passes, inclusive, that use it
+struct TransientRequest {
+  bool isImage;
+  TransientImageDesc image;
+  TransientBufferDesc buffer;
+  uint32_t firstPass;
+  uint32_t lastPass;
+
+  bool operator==(const TransientRequest &) const = default;
+};
+
+struct TransientResource {
+  VkImage image{VK_NULL_HANDLE};
+  VkImageView view{VK_NULL_HANDLE};
+  VkBuffer buffer{VK_NULL_HANDLE};
+};
+
+// places transient resources into as few device local memory blocks as
+// their lifetimes allow. the placement is kept while the requests don't
+// change, so steady frames create nothing
+class TransientAllocator {
+public:
+  // replaced placements, which the frames in flight may still use, are
+  // retired through retirement
+  void init(VkDevice device, VmaAllocator allocator,
+            RetirementQueue *retirement, MemoryTelemetry *telemetry);
+  void cleanup();
+
+  // one resource per request, in request order
+  std::span<const TransientResource>
+  allocate(std::span<const TransientRequest> requests);
+
+  struct Stats {
+    uint32_t resources{0};
+    uint32_t blocks{0};
+    // memory the resources would need with an allocation each
+    VkDeviceSize requestedBytes{0};
+    VkDeviceSize allocatedBytes{0};
+
+    VkDeviceSize saved_bytes() const { return requestedBytes - allocatedBytes; }
+  };
+  const Stats &stats() const { return _stats; }
+
+private:
+  struct Placement {
+    std::vector<TransientResource> resources;
+    std::vector<VmaAllocation> blocks;
+    VkDeviceSize bytes{0};
+  };
+
+  Placement build(std::span<const TransientRequest> requests);
+  void destroy(const Placement &placement);
+  void retire(const Placement &placement);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  RetirementQueue *_retirement{nullptr};
+  MemoryTelemetry *_telemetry{nullptr};
+
+  std::vector<TransientRequest> _requests;
+  Placement _placement;
+  Stats _stats;
+};
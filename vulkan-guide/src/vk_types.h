@@ -29,18 +29,34 @@
     }                                                                          \
   } while (0)
 
+// a value on the upload queue's timeline. the resource can be used once
+// UploadQueue::is_ready says so
+struct UploadTicket {
+  uint64_t value{0};
+};
+
 struct AllocatedImage {
   VkImage image;
   VkImageView imageView;
   VmaAllocation allocation;
   VkExtent3D imageExtent;
   VkFormat imageFormat;
+  // to create a copy of the image when its memory is moved
+  VkImageUsageFlags imageUsage;
+  uint32_t mipLevels;
+  // the image's slot in the bindless heap, while it is in the image pool
+  uint32_t bindlessIndex;
+  // the upload of the initial contents, if any
+  UploadTicket upload;
 };
 
 struct AllocatedBuffer {
   VkBuffer buffer;
   VmaAllocation allocation;
   VmaAllocationInfo info;
+  // what the buffer was created with
+  VkBufferUsageFlags usage;
+  VkDeviceSize size;
 };
 
 struct Vertex {
@@ -52,18 +68,40 @@ struct Vertex {
   glm::vec4 color;
 };
 
+// a mesh's vertices and indices in a block of the geometry pool. offsets
+// and counts are in vertices and indices, not bytes
+struct GeometryRange {
+  uint32_t block{0};
+  uint32_t vertexOffset{0};
+  uint32_t vertexCount{0};
+  uint32_t firstIndex{0};
+  uint32_t indexCount{0};
+};
+
 // holds the resources needed for a mesh
 struct GPUMeshBuffers {
 
-  AllocatedBuffer indexBuffer;
-  AllocatedBuffer vertexBuffer;
-  VkDeviceAddress vertexBufferAddress;
+  GeometryRange geometry;
+  UploadTicket upload;
 };
 
 // push constants for our mesh object draws
 struct GPUDrawPushConstants {
   glm::mat4 worldMatrix;
   VkDeviceAddress vertexBuffer;
+  // into the material table
+  uint32_t materialIndex;
+};
+
+// a material's record in the material table, std430 packed. textures and
+// samplers are slots in the bindless heap
+struct GPUMaterialData {
+  glm::vec4 colorFactors;
+  glm::vec4 metal_rough_factors;
+  uint32_t colorTexture;
+  uint32_t colorSampler;
+  uint32_t metalRoughTexture;
+  uint32_t metalRoughSampler;
 };
 
 enum class MaterialPass : uint8_t { MainColor, Transparent, Other };
@@ -74,8 +112,9 @@ struct MaterialPipeline {
 
 struct MaterialInstance {
   MaterialPipeline *pipeline;
-  VkDescriptorSet materialSet;
   MaterialPass passType;
+  // the material's parameters in the material table
+  uint32_t materialIndex;
 };
 
 struct DrawContext;
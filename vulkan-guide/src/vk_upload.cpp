@@ -0,0 +1,356 @@
+#include <vk_upload.h>
+
+#include <algorithm>
+
+#include <vk_initializers.h>
+
+namespace {
+// covers the texel size of every format uploaded so far and the 4 byte
+// alignment buffer to image copies need
+constexpr VkDeviceSize StagingAlignment = 16;
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+void UploadQueue::init(VkDevice device, VmaAllocator allocator, VkQueue queue,
+                       uint32_t queueFamily, uint32_t graphicsQueueFamily,
+                       VkDeviceSize stagingSize,
+                       MemoryTelemetry *telemetry) {
+  _device = device;
+  _allocator = allocator;
+  _telemetry = telemetry;
+  _queue = queue;
+  _queueFamily = queueFamily;
+  _graphicsQueueFamily = graphicsQueueFamily;
+  _ownershipTransfer = queueFamily != graphicsQueueFamily;
+
+  VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(
+      _queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+  VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_pool));
+
+  VkSemaphoreTypeCreateInfo timelineCreateInfo =
+      vkinit::semaphore_type_create_info(VK_SEMAPHORE_TYPE_TIMELINE, 0);
+  VkSemaphoreCreateInfo timelineInfo = vkinit::semaphore_create_info();
+  timelineInfo.pNext = &timelineCreateInfo;
+  VK_CHECK(vkCreateSemaphore(_device, &timelineInfo, nullptr, &_timeline));
+
+  _ringSize = align_up(stagingSize, StagingAlignment);
+
+  VkBufferCreateInfo bufferInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bufferInfo.size = _ringSize;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+  VmaAllocationCreateInfo vmaallocInfo = {};
+  vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+  vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+                           &_ring.buffer, &_ring.allocation, &_ring.info));
+  _telemetry->add(MemoryCategory::Staging, _ring.info.size);
+}
+
+void UploadQueue::cleanup() {
+  destroy_staging(_batch);
+  for (Batch &batch : _inFlight) {
+    destroy_staging(batch);
+  }
+  _inFlight.clear();
+  _freeCommandBuffers.clear();
+
+  vmaDestroyBuffer(_allocator, _ring.buffer, _ring.allocation);
+  _telemetry->remove(MemoryCategory::Staging, _ring.info.size);
+  vkDestroyCommandPool(_device, _pool, nullptr);
+  vkDestroySemaphore(_device, _timeline, nullptr);
+}
+
+StagingAllocation UploadQueue::stage(VkDeviceSize size) {
+  if (size > _ringSize) {
+    if (!_batchOpen) {
+      begin_batch();
+    }
+
+    AllocatedBuffer staging;
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo vmaallocInfo = {};
+    vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+                             &staging.buffer, &staging.allocation,
+                             &staging.info));
+
+    _telemetry->add(MemoryCategory::Staging, staging.info.size);
+    _batch.dedicatedStaging.push_back(staging);
+    _stats.dedicatedStaging++;
+    return {staging.buffer, 0, staging.info.pMappedData};
+  }
+
+  uint64_t start = ring_start(size);
+  if (start + size - _ringTail > _ringSize) {
+    uint64_t finishedValue;
+    VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &finishedValue));
+    reclaim_staging(finishedValue);
+    start = ring_start(size);
+  }
+
+  if (start + size - _ringTail > _ringSize) {
+    // the rest of the ring belongs to the open batch and the ones in
+    // flight. send the open one off and wait for the oldest until the
+    // upload fits
+    if (_batchOpen) {
+      flush();
+      _stats.ringFlushes++;
+    }
+    for (const Batch &batch : _inFlight) {
+      wait_value(batch.value);
+      reclaim_staging(batch.value);
+      start = ring_start(size);
+      if (start + size - _ringTail <= _ringSize) {
+        break;
+      }
+    }
+  }
+
+  if (!_batchOpen) {
+    begin_batch();
+  }
+
+  _ringHead = start + size;
+  _batch.ringEnd = _ringHead;
+
+  VkDeviceSize offset = start % _ringSize;
+  return {_ring.buffer, offset,
+          static_cast<char *>(_ring.info.pMappedData) + offset};
+}
+
+UploadTicket
+UploadQueue::record(std::function<void(VkCommandBuffer cmd)> &&record,
+                    std::span<const UploadBufferRelease> buffers,
+                    std::span<const UploadImageRelease> images) {
+  if (!_batchOpen) {
+    begin_batch();
+  }
+
+  record(_batch.cmd);
+
+  // the release half of the ownership transfer, recorded when the batch
+  // is flushed. the acquire half repeats it on graphics, with the same
+  // families and layouts. on a graphics family the barrier only has to
+  // transition the images
+  uint32_t srcFamily =
+      _ownershipTransfer ? _queueFamily : VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dstFamily =
+      _ownershipTransfer ? _graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+
+  for (const UploadBufferRelease &release : buffers) {
+    VkBufferMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = release.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    _batch.bufferReleases.push_back(barrier);
+
+    if (_ownershipTransfer) {
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.srcAccessMask = VK_ACCESS_2_NONE;
+      barrier.dstStageMask = release.dstStages;
+      barrier.dstAccessMask = release.dstAccess;
+      _batch.bufferAcquires.push_back(barrier);
+    }
+  }
+
+  for (const UploadImageRelease &release : images) {
+    VkImageMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = release.layout;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.image = release.image;
+    barrier.subresourceRange = vkinit::image_subresource_range(release.aspect);
+    _batch.imageReleases.push_back(barrier);
+
+    if (_ownershipTransfer) {
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.srcAccessMask = VK_ACCESS_2_NONE;
+      barrier.dstStageMask = release.dstStages;
+      barrier.dstAccessMask = release.dstAccess;
+      _batch.imageAcquires.push_back(barrier);
+    }
+  }
+
+  _stats.uploads++;
+  return {_batch.value};
+}
+
+void UploadQueue::flush() {
+  if (!_batchOpen) {
+    return;
+  }
+
+  VkCommandBuffer cmd = _batch.cmd;
+
+  VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  depInfo.bufferMemoryBarrierCount =
+      static_cast<uint32_t>(_batch.bufferReleases.size());
+  depInfo.pBufferMemoryBarriers = _batch.bufferReleases.data();
+  depInfo.imageMemoryBarrierCount =
+      static_cast<uint32_t>(_batch.imageReleases.size());
+  depInfo.pImageMemoryBarriers = _batch.imageReleases.data();
+  vkCmdPipelineBarrier2(cmd, &depInfo);
+  _batch.bufferReleases.clear();
+  _batch.imageReleases.clear();
+
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+  VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(
+      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _timeline, _batch.value);
+  VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, nullptr);
+  VK_CHECK(vkQueueSubmit2(_queue, 1, &submit, VK_NULL_HANDLE));
+
+  _submittedValue = _batch.value;
+  _stats.batches++;
+
+  _inFlight.push_back(std::move(_batch));
+  _batch = {};
+  _batchOpen = false;
+}
+
+void UploadQueue::begin_batch() {
+  _batch.value = _submittedValue + 1;
+  _batch.ringEnd = _ringHead;
+
+  if (_freeCommandBuffers.empty()) {
+    VkCommandBufferAllocateInfo allocInfo =
+        vkinit::command_buffer_allocate_info(_pool, 1);
+    VK_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &_batch.cmd));
+  } else {
+    _batch.cmd = _freeCommandBuffers.back();
+    _freeCommandBuffers.pop_back();
+  }
+
+  VK_CHECK(vkResetCommandBuffer(_batch.cmd, 0));
+  VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  VK_CHECK(vkBeginCommandBuffer(_batch.cmd, &cmdBeginInfo));
+
+  _batchOpen = true;
+}
+
+uint64_t UploadQueue::ring_start(VkDeviceSize size) {
+  // nothing is in use, start over at the beginning of the buffer
+  if (_ringTail == _ringHead) {
+    _ringHead = align_up(_ringHead, _ringSize);
+    _ringTail = _ringHead;
+  }
+
+  uint64_t start = align_up(_ringHead, StagingAlignment);
+  // an allocation never wraps around the end of the buffer
+  if (start % _ringSize + size > _ringSize) {
+    start = align_up(start, _ringSize);
+  }
+  return start;
+}
+
+void UploadQueue::reclaim_staging(uint64_t finishedValue) {
+  for (const Batch &batch : _inFlight) {
+    if (batch.value > finishedValue) {
+      break;
+    }
+    _ringTail = std::max(_ringTail, batch.ringEnd);
+  }
+}
+
+void UploadQueue::destroy_staging(Batch &batch) {
+  for (AllocatedBuffer &staging : batch.dedicatedStaging) {
+    vmaDestroyBuffer(_allocator, staging.buffer, staging.allocation);
+    _telemetry->remove(MemoryCategory::Staging, staging.info.size);
+  }
+  batch.dedicatedStaging.clear();
+}
+
+uint64_t UploadQueue::acquire_finished(VkCommandBuffer cmd) {
+  if (_inFlight.empty()) {
+    return 0;
+  }
+
+  uint64_t finishedValue;
+  VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &finishedValue));
+
+  uint64_t waitValue = 0;
+  while (!_inFlight.empty() && _inFlight.front().value <= finishedValue) {
+    Batch &batch = _inFlight.front();
+    _bufferBarriers.insert(_bufferBarriers.end(),
+                           batch.bufferAcquires.begin(),
+                           batch.bufferAcquires.end());
+    _imageBarriers.insert(_imageBarriers.end(), batch.imageAcquires.begin(),
+                          batch.imageAcquires.end());
+
+    // the copies are done, so are the staging memory and command buffer
+    _ringTail = std::max(_ringTail, batch.ringEnd);
+    destroy_staging(batch);
+    _freeCommandBuffers.push_back(batch.cmd);
+
+    waitValue = batch.value;
+    _inFlight.pop_front();
+  }
+
+  if (!_bufferBarriers.empty() || !_imageBarriers.empty()) {
+    VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.bufferMemoryBarrierCount =
+        static_cast<uint32_t>(_bufferBarriers.size());
+    depInfo.pBufferMemoryBarriers = _bufferBarriers.data();
+    depInfo.imageMemoryBarrierCount =
+        static_cast<uint32_t>(_imageBarriers.size());
+    depInfo.pImageMemoryBarriers = _imageBarriers.data();
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+    _bufferBarriers.clear();
+    _imageBarriers.clear();
+  }
+
+  if (waitValue != 0) {
+    _acquiredValue = waitValue;
+  }
+  return waitValue;
+}
+
+void UploadQueue::wait(UploadTicket ticket) {
+  if (ticket.value == 0) {
+    return;
+  }
+
+  if (_batchOpen && ticket.value == _batch.value) {
+    flush();
+  }
+  wait_value(ticket.value);
+}
+
+void UploadQueue::wait_all() {
+  flush();
+  wait_value(_submittedValue);
+}
+
+void UploadQueue::wait_value(uint64_t value) {
+  if (value == 0) {
+    return;
+  }
+
+  VkSemaphoreWaitInfo waitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &_timeline;
+  waitInfo.pValues = &value;
+  VK_CHECK(vkWaitSemaphores(_device, &waitInfo, UINT64_MAX));
+}
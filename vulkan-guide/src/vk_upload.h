@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vk_memory_telemetry.h>
+#include <vk_types.h>
+
+// a buffer written by an upload, and how graphics will use it
+struct UploadBufferRelease {
+  VkBuffer buffer;
+  VkPipelineStageFlags2 dstStages;
+  VkAccessFlags2 dstAccess;
+};
+
+// an image written by an upload. the copies leave it in
+// TRANSFER_DST_OPTIMAL, the release transitions it to layout
+struct UploadImageRelease {
+  VkImage image;
+  VkImageAspectFlags aspect;
+  VkImageLayout layout;
+  VkPipelineStageFlags2 dstStages;
+  VkAccessFlags2 dstAccess;
+};
+
+// staging memory for one upload, written through data and copied from
+// buffer at offset
+struct StagingAllocation {
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  void *data;
+};
+
+// copies into device local resources on a transfer queue, without blocking
+// the caller or the graphics queue. uploads are staged in a persistent ring
+// and recorded into one open batch, which is submitted by flush(), when the
+// ring fills up, or when a caller waits on it. when the transfer queue
+// belongs to another family, finished uploads are released to graphics on
+// the transfer queue and acquired at the start of the next frame.
+// completion is tracked on a timeline semaphore, every batch signals the
+// next value. main thread only
+class UploadQueue {
+public:
+  void init(VkDevice device, VmaAllocator allocator, VkQueue queue,
+            uint32_t queueFamily, uint32_t graphicsQueueFamily,
+            VkDeviceSize stagingSize, MemoryTelemetry *telemetry);
+  // the queue has to be idle
+  void cleanup();
+
+  // staging memory for an upload recorded right after. may flush the open
+  // batch and wait for older ones to make room. uploads larger than the
+  // ring get a staging buffer of their own
+  StagingAllocation stage(VkDeviceSize size);
+
+  // records the copies into the open batch. the ticket stays valid for
+  // every resource the batch writes
+  UploadTicket record(std::function<void(VkCommandBuffer cmd)> &&record,
+                      std::span<const UploadBufferRelease> buffers,
+                      std::span<const UploadImageRelease> images);
+
+  // submits the open batch, if it recorded anything
+  void flush();
+
+  // records the acquire barriers of every upload that has finished so far,
+  // at the start of a graphics command buffer. returns the upload timeline
+  // value the command buffer's submit has to wait on, 0 if none. the
+  // value has already been reached, so the wait doesn't stall
+  uint64_t acquire_finished(VkCommandBuffer cmd);
+
+  // true once the resources of the ticket can be used by graphics commands
+  // recorded after the last acquire_finished()
+  bool is_ready(UploadTicket ticket) const {
+    return ticket.value <= _acquiredValue;
+  }
+  uint64_t acquired_value() const { return _acquiredValue; }
+
+  // blocks until the upload has finished on the transfer queue, flushing
+  // it first if needed. it still has to be acquired before graphics can
+  // use it
+  void wait(UploadTicket ticket);
+  void wait_all();
+
+  VkSemaphore timeline() const { return _timeline; }
+  // batches submitted and not yet acquired
+  size_t pending() const { return _inFlight.size(); }
+
+  struct Stats {
+    uint64_t uploads{0};
+    uint64_t batches{0};
+    // batches submitted early because the ring had no room left
+    uint64_t ringFlushes{0};
+    // uploads that didn't fit the ring
+    uint64_t dedicatedStaging{0};
+  };
+  const Stats &stats() const { return _stats; }
+
+private:
+  struct Batch {
+    uint64_t value{0};
+    VkCommandBuffer cmd{VK_NULL_HANDLE};
+    // ring position once the batch's staging data is no longer read
+    uint64_t ringEnd{0};
+    std::vector<AllocatedBuffer> dedicatedStaging;
+    std::vector<VkBufferMemoryBarrier2> bufferReleases;
+    std::vector<VkImageMemoryBarrier2> imageReleases;
+    std::vector<VkBufferMemoryBarrier2> bufferAcquires;
+    std::vector<VkImageMemoryBarrier2> imageAcquires;
+  };
+
+  void begin_batch();
+  // ring position an allocation of size would start at
+  uint64_t ring_start(VkDeviceSize size);
+  // moves the ring tail past every batch the timeline has reached
+  void reclaim_staging(uint64_t finishedValue);
+  void destroy_staging(Batch &batch);
+  void wait_value(uint64_t value);
+
+  VkDevice _device{VK_NULL_HANDLE};
+  VmaAllocator _allocator{VK_NULL_HANDLE};
+  MemoryTelemetry *_telemetry{nullptr};
+  VkQueue _queue{VK_NULL_HANDLE};
+  uint32_t _queueFamily{0};
+  uint32_t _graphicsQueueFamily{0};
+  // false when the uploads run on a graphics family queue
+  bool _ownershipTransfer{false};
+
+  VkCommandPool _pool{VK_NULL_HANDLE};
+  std::vector<VkCommandBuffer> _freeCommandBuffers;
+
+  VkSemaphore _timeline{VK_NULL_HANDLE};
+  uint64_t _submittedValue{0};
+  uint64_t _acquiredValue{0};
+
+  // the ring is addressed with ever growing positions, the offset in the
+  // buffer is the position modulo its size. [tail, head) is in use
+  AllocatedBuffer _ring{};
+  VkDeviceSize _ringSize{0};
+  uint64_t _ringHead{0};
+  uint64_t _ringTail{0};
+
+  bool _batchOpen{false};
+  Batch _batch;
+  // oldest first, they finish in submit order
+  std::deque<Batch> _inFlight;
+
+  std::vector<VkBufferMemoryBarrier2> _bufferBarriers;
+  std::vector<VkImageMemoryBarrier2> _imageBarriers;
+
+  Stats _stats;
+};